@@ -56,6 +56,101 @@ G1::G1(const Pairing &e, const void *data,
   }else throw UndefinedPairingException();
 }
 
+//Exponentiation: with GLV constants, exp = k1 + k2*lambda mod r where
+//k1 and k2 are about half as long, and g^exp = g^k1 * phi(g)^k2
+G1& G1::operator^=(const Zr &exp){
+  if(!(elementPresent && exp.isElementPresent()))
+	throw UndefinedElementException();
+  const GLVParams *glv = Pairing::getGLV(g);
+  if (!glv || element_is1(g))
+	return (G1&)G::operator^=(exp);
+
+  mpz_t k, c1, c2, k1, k2, den;
+  mpz_init(k); mpz_init(c1); mpz_init(c2);
+  mpz_init(k1); mpz_init(k2); mpz_init(den);
+  element_to_mpz(k, *(element_t*)&exp.getElement());
+
+  //c1 = round(b2*k/r), c2 = round(-b1*k/r)
+  mpz_mul_2exp(den, glv->r, 1);
+  mpz_mul(c1, glv->b2, k); mpz_mul_2exp(c1, c1, 1); mpz_add(c1, c1, glv->r);
+  mpz_fdiv_q(c1, c1, den);
+  mpz_mul(c2, glv->b1, k); mpz_neg(c2, c2); mpz_mul_2exp(c2, c2, 1); mpz_add(c2, c2, glv->r);
+  mpz_fdiv_q(c2, c2, den);
+  //k1 = k - c1*a1 - c2*a2, k2 = -c1*b1 - c2*b2
+  mpz_set(k1, k); mpz_submul(k1, c1, glv->a1); mpz_submul(k1, c2, glv->a2);
+  mpz_set_ui(k2, 0); mpz_submul(k2, c1, glv->b1); mpz_submul(k2, c2, glv->b2);
+
+  element_t base1, base2;
+  element_init_same_as(base1, g);
+  element_init_same_as(base2, g);
+  element_set(base1, g);
+  element_set(base2, g);
+  element_mul(element_x(base2), element_x(base2), *(element_t*)&glv->beta);
+  //pow2 wants nonnegative exponents; move the signs onto the bases
+  if (mpz_sgn(k1) < 0){ mpz_neg(k1, k1); element_invert(base1, base1);}
+  if (mpz_sgn(k2) < 0){ mpz_neg(k2, k2); element_invert(base2, base2);}
+  element_pow2_mpz(g, base1, k1, base2, k2);
+
+  element_clear(base1); element_clear(base2);
+  mpz_clear(k); mpz_clear(c1); mpz_clear(c2);
+  mpz_clear(k1); mpz_clear(k2); mpz_clear(den);
+  return *this;
+}
+
+const G1 G1::multiexp(const vector<G1> &bases, const vector<Zr> &exps){
+  if (bases.empty() || bases.size() != exps.size())
+	throw UndefinedElementException();
+  const size_t n = bases.size();
+  for (size_t i = 0; i < n; ++i){
+	if (!(bases[i].isElementPresent() && exps[i].isElementPresent()))
+	  throw UndefinedElementException();
+  }
+  const int window = 4, tableSize = 1 << window;
+
+  //table[i*tableSize + d] = bases[i]^d
+  mpz_t *k = new mpz_t[n];
+  element_t *table = new element_t[n * tableSize];
+  size_t bits = 0;
+  for (size_t i = 0; i < n; ++i){
+	mpz_init(k[i]);
+	element_to_mpz(k[i], *(element_t*)&exps[i].getElement());
+	if (mpz_sgn(k[i]) && mpz_sizeinbase(k[i], 2) > bits)
+	  bits = mpz_sizeinbase(k[i], 2);
+	element_t *row = table + i * tableSize;
+	element_t &base = *(element_t*)&bases[i].getElement();
+	element_init_same_as(row[0], base);
+	element_set1(row[0]);
+	element_init_same_as(row[1], base);
+	element_set(row[1], base);
+	for (int d = 2; d < tableSize; ++d){
+	  element_init_same_as(row[d], base);
+	  element_mul(row[d], row[d - 1], base);
+	}
+  }
+
+  G1 result(bases[0], true);
+  element_t &acc = *(element_t*)&result.getElement();
+  long top = ((long)bits + window - 1) / window - 1;
+  for (long w = top; w >= 0; --w){
+	if (w < top)
+	  for (int s = 0; s < window; ++s) element_square(acc, acc);
+	for (size_t i = 0; i < n; ++i){
+	  int digit = 0;
+	  for (int b = window - 1; b >= 0; --b)
+		digit = (digit << 1) | mpz_tstbit(k[i], w * window + b);
+	  if (digit) element_mul(acc, acc, table[i * tableSize + digit]);
+	}
+  }
+
+  for (size_t i = 0; i < n; ++i){
+	mpz_clear(k[i]);
+	for (int d = 0; d < tableSize; ++d) element_clear(table[i * tableSize + d]);
+  }
+  delete[] k;
+  delete[] table;
+  return result;
+}
+
 //Overriden getElementSize to take care of compressed elements
 unsigned short G1::getElementSize(bool compressed) const{
   if (!elementPresent)
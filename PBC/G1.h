@@ -1,6 +1,7 @@
 #ifndef __G1_H__
 #define __G1_H__
 
+#include <vector>
 #include "G.h"
 using namespace std;
 
@@ -33,7 +34,14 @@ public:
   //Arithmetic Assignment Operators
   G1& operator*=(const G1 &rhs){return (G1&)G::operator*=(rhs);}
   G1& operator/=(const G1 &rhs){return (G1&)G::operator/=(rhs);}
-  G1& operator^=(const Zr &exp){return (G1&)G::operator^=(exp);}
+  //Uses a GLV split of exp when the pairing has an endomorphism on G1
+  G1& operator^=(const Zr &exp);
+
+  //prod bases[i]^exps[i] by interleaved (Straus) exponentiation with 4 bit
+  //windows: the squarings are shared, so it costs about as many of them
+  //as one exponentiation by the longest exponent, plus 15 + bits/4
+  //multiplications per base. Short exponents make it cheap.
+  static const G1 multiexp(const vector<G1> &bases, const vector<Zr> &exps);
 
   // Non-assignment operators
   const G1 operator*(const G1 &rhs) const {
@@ -3,6 +3,65 @@
 #include "G2.h"
 #include "GT.h"
 #include "PBCExceptions.h"
+#include <map>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+//Every live pairing by its G1 field, for G1 exponentiation to find its
+//GLV constants
+static map<field_ptr, Pairing*> glvRegistry;
+static pthread_rwlock_t glvRegistryLock = PTHREAD_RWLOCK_INITIALIZER;
+
+//Random numbers for PBC. Each thread reads /dev/urandom through a buffer
+//of its own instead of sharing PBC's default source.
+#define RANDOM_BUFFER 4096
+static int urandomfd = -1;
+static pthread_once_t randomOnce = PTHREAD_ONCE_INIT;
+static __thread unsigned char randomBuf[RANDOM_BUFFER];
+static __thread size_t randomLeft = 0;
+
+static void randomBytes(unsigned char *out, size_t len){
+  while (len){
+	if (!randomLeft){
+	  size_t got = 0;
+	  while (got < RANDOM_BUFFER){
+		ssize_t n = read(urandomfd, randomBuf + got, RANDOM_BUFFER - got);
+		//Called from inside PBC, so there is no throwing from here
+		if (n <= 0){
+		  perror("/dev/urandom");
+		  abort();
+		}
+		got += n;
+	  }
+	  randomLeft = RANDOM_BUFFER;
+	}
+	size_t n = len < randomLeft ? len : randomLeft;
+	unsigned char *src = randomBuf + RANDOM_BUFFER - randomLeft;
+	memcpy(out, src, n);
+	memset(src, 0, n);
+	randomLeft -= n; out += n; len -= n;
+  }
+}
+
+//Uniform in [0, limit): 64 extra bits before reducing
+static void threadMpzRandom(mpz_t z, mpz_t limit, void *){
+  size_t len = (mpz_sizeinbase(limit, 2) + 64 + 7) / 8;
+  unsigned char buf[len];
+  randomBytes(buf, len);
+  mpz_import(z, len, 1, 1, 0, 0, buf);
+  memset(buf, 0, len);
+  mpz_mod(z, z, limit);
+}
+
+static void initRandom(){
+  urandomfd = open("/dev/urandom", O_RDONLY);
+  //Without it PBC keeps its own source, which is only safe on one thread
+  if (urandomfd >= 0) pbc_random_set_function(threadMpzRandom, NULL);
+}
 
 //Create using a buffer
 Pairing::Pairing(const char * buf, size_t len){
@@ -12,6 +71,7 @@ Pairing::Pairing(const char * buf, size_t len){
 	  pairingPresent = false;
 	else
 	  pairingPresent = true;
+  initShared();
 }
 
 //Create using a ASCIIZ string
@@ -22,6 +82,7 @@ Pairing::Pairing(const char * buf){
 	  pairingPresent = false;
 	else
 	  pairingPresent = true;
+  initShared();
 }
 
 //Create using a File Stream
@@ -32,10 +93,18 @@ Pairing::Pairing(const FILE * buf){
   if (count) 
 	if (!pairing_init_set_buf(e, s, count)) 
 	  pairingPresent = true;
+  initShared();
 }
 
 //Destructor
 Pairing::~Pairing(){
+  if (pairingPresent){
+	pthread_rwlock_wrlock(&glvRegistryLock);
+	glvRegistry.erase(e->G1);
+	pthread_rwlock_unlock(&glvRegistryLock);
+  }
+  clearGLV();
+  pthread_mutex_destroy(&glvLock);
   if (pairingPresent){
 	pairing_clear(e);
 	pairingPresent = false;
@@ -149,6 +218,160 @@ size_t Pairing::getElementSize(PairingElementType type,
   }else throw UndefinedPairingException();
 }
 
+//PBC fills in some of the pairing's fields on first use. Do that here, so
+//that afterwards the pairing is only read and can be shared by threads.
+void Pairing::initShared(){
+  pthread_once(&randomOnce, initRandom);
+  glv = NULL;
+  glvChecked = false;
+  pthread_mutex_init(&glvLock, NULL);
+  if (!pairingPresent) return;
+  pthread_rwlock_wrlock(&glvRegistryLock);
+  glvRegistry[e->G1] = this;
+  pthread_rwlock_unlock(&glvRegistryLock);
+  //Square roots (decompression, hashing to points) need a non-residue
+  element_t P;
+  element_init_G1(P, e);
+  field_get_nqr(element_x(P)->field);
+  element_clear(P);
+  if (!pairing_is_symmetric(e)){
+	element_init_G2(P, e);
+	field_get_nqr(element_x(P)->field);
+	element_clear(P);
+  }
+  field_get_nqr(e->Zr);
+}
+
+//initGLV() takes a random point and exponentiations, which are not spent
+//on a Pairing until G1 is exponentiated in it
+const GLVParams *Pairing::checkGLV(){
+  pthread_mutex_lock(&glvLock);
+  if (!glvChecked) {
+	initGLV();
+	glvChecked = true;
+  }
+  pthread_mutex_unlock(&glvLock);
+  return glv;
+}
+
+//Look for the endomorphism (x,y) -> (beta*x,y) on G1 and precompute
+//the lattice basis used to split exponents. Leaves glv NULL if the
+//curve has no such endomorphism (type A and D curves do not).
+void Pairing::initGLV(){
+  glv = NULL;
+  if (!pairingPresent) return;
+
+  element_t P, Q, phiP;
+  element_init_G1(P, e);
+  element_random(P);
+  if (element_is1(P)) element_random(P);
+  mpz_ptr q = element_x(P)->field->order;
+  if (mpz_fdiv_ui(q, 3) != 1 || mpz_fdiv_ui(e->r, 3) != 1){
+	element_clear(P);
+	return;
+  }
+  
+  GLVParams *params = new GLVParams;
+  element_init_same_as(params->beta, element_x(P));
+  mpz_init_set(params->r, e->r);
+  mpz_init(params->lambda);
+  mpz_init(params->a1); mpz_init(params->b1);
+  mpz_init(params->a2); mpz_init(params->b2);
+  
+  //Nontrivial cube roots of unity in Fq and Zr
+  mpz_t exp;
+  mpz_init(exp);
+  mpz_sub_ui(exp, q, 1); mpz_divexact_ui(exp, exp, 3);
+  for (long z = 2; ; ++z){
+	element_set_si(params->beta, z);
+	element_pow_mpz(params->beta, params->beta, exp);
+	if (!element_is1(params->beta)) break;
+  }
+  mpz_sub_ui(exp, params->r, 1); mpz_divexact_ui(exp, exp, 3);
+  for (unsigned long z = 2; ; ++z){
+	mpz_set_ui(params->lambda, z);
+	mpz_powm(params->lambda, params->lambda, exp, params->r);
+	if (mpz_cmp_ui(params->lambda, 1)) break;
+  }
+
+  //Match lambda to beta: the other root is lambda^2 = -1-lambda
+  element_init_same_as(Q, P);
+  element_init_same_as(phiP, P);
+  element_set(phiP, P);
+  element_mul(element_x(phiP), element_x(phiP), params->beta);
+  bool found = false;
+  for (int tries = 0; tries < 2 && !found; ++tries){
+	element_pow_mpz(Q, P, params->lambda);
+	if (!element_cmp(Q, phiP)) found = true;
+	else {
+	  mpz_add_ui(params->lambda, params->lambda, 1);
+	  mpz_sub(params->lambda, params->r, params->lambda);
+	}
+  }
+  element_clear(phiP);
+  element_clear(Q);
+  element_clear(P);
+
+  if (found){
+	//Extended Euclid on (r, lambda): r_i = t_i*lambda mod r. Stop around sqrt(r)
+	mpz_t sqrtr, r0, r1, r2, t0, t1, t2, quot, tmp, tmp2;
+	mpz_init(sqrtr); mpz_sqrt(sqrtr, params->r);
+	mpz_init_set(r0, params->r); mpz_init_set(r1, params->lambda); mpz_init(r2);
+	mpz_init_set_ui(t0, 0); mpz_init_set_ui(t1, 1); mpz_init(t2);
+	mpz_init(quot); mpz_init(tmp); mpz_init(tmp2);
+	while (mpz_cmp(r1, sqrtr) >= 0){
+	  mpz_fdiv_qr(quot, r2, r0, r1);
+	  mpz_mul(tmp, quot, t1); mpz_sub(t2, t0, tmp);
+	  mpz_swap(r0, r1); mpz_swap(r1, r2);
+	  mpz_swap(t0, t1); mpz_swap(t1, t2);
+	}
+	//Now r0 >= sqrt(r) > r1: v1 = (r1, -t1)
+	mpz_set(params->a1, r1); mpz_neg(params->b1, t1);
+	//v2 is the shorter of (r0, -t0) and the next remainder pair
+	mpz_fdiv_qr(quot, r2, r0, r1);
+	mpz_mul(tmp, quot, t1); mpz_sub(t2, t0, tmp);
+	mpz_mul(tmp, r0, r0); mpz_addmul(tmp, t0, t0);
+	mpz_mul(tmp2, r2, r2); mpz_addmul(tmp2, t2, t2);
+	if (mpz_cmp(tmp, tmp2) <= 0){
+	  mpz_set(params->a2, r0); mpz_neg(params->b2, t0);
+	} else {
+	  mpz_set(params->a2, r2); mpz_neg(params->b2, t2);
+	}
+	//Keep det = a1*b2 - a2*b1 = +r so that rounding in G1 stays simple
+	mpz_mul(tmp, params->a1, params->b2); mpz_submul(tmp, params->a2, params->b1);
+	if (mpz_sgn(tmp) < 0){
+	  mpz_swap(params->a1, params->a2); mpz_swap(params->b1, params->b2);
+	}
+	mpz_clear(sqrtr); mpz_clear(r0); mpz_clear(r1); mpz_clear(r2);
+	mpz_clear(t0); mpz_clear(t1); mpz_clear(t2);
+	mpz_clear(quot); mpz_clear(tmp); mpz_clear(tmp2);
+
+	glv = params;
+  } else {
+	glv = params;
+	clearGLV();
+  }
+  mpz_clear(exp);
+}
+
+void Pairing::clearGLV(){
+  if (!glv) return;
+  element_clear(glv->beta);
+  mpz_clear(glv->lambda); mpz_clear(glv->r);
+  mpz_clear(glv->a1); mpz_clear(glv->b1);
+  mpz_clear(glv->a2); mpz_clear(glv->b2);
+  delete glv;
+  glv = NULL;
+}
+
+const GLVParams* Pairing::getGLV(const element_t& g){
+  pthread_rwlock_rdlock(&glvRegistryLock);
+  map<field_ptr, Pairing*>::const_iterator it = glvRegistry.find(g->field);
+  Pairing *pairing = (it == glvRegistry.end())? NULL : it->second;
+  pthread_rwlock_unlock(&glvRegistryLock);
+  return pairing ? pairing->checkGLV() : NULL;
+}
+
 /*
 //Generate parameters for type A pairing
 void Pairing::
@@ -2,6 +2,7 @@
 #define __Pairing_H__
 
 #include <string>
+#include <pthread.h>
 #include <gmp.h>
 extern "C" {
 #include <pbc/pbc.h>
@@ -15,11 +16,25 @@ class GT;
 
 typedef enum {Type_G1, Type_G2, Type_GT, Type_Zr} PairingElementType;
 
+//Constants for GLV exponentiation in G1. Only set up for curves
+//y^2 = x^3 + b (e.g. type F), where (x,y) -> (beta*x,y) is P -> P^lambda
+struct GLVParams{
+  element_t beta;//Cube root of unity in the base field
+  mpz_t lambda;//Matching cube root of unity modulo r
+  mpz_t r;
+  mpz_t a1, b1, a2, b2;//Short basis of {(x,y) : x + y*lambda = 0 mod r}
+};
+
+//A pairing may be used by several threads at once, as may elements that
+//are only read. Each thread needs its own elements to write to.
 class Pairing{
 public:
   //Create a null pairing
   Pairing(){
 	pairingPresent = false;
+	glv = NULL;
+	glvChecked = true;
+	pthread_mutex_init(&glvLock, NULL);
   }
 
   //Create using a buffer
@@ -61,6 +76,10 @@ public:
   size_t getElementSize(PairingElementType type, 
 						bool compressed = false) const;
 
+  //GLV constants for the G1 group of element g, or NULL if there are none.
+  //They are worked out on the first call for each pairing.
+  static const GLVParams* getGLV(const element_t& g);
+
   /*
   //Generate parameters for type A pairing
   static void 
@@ -111,8 +130,16 @@ private:
   // Assignment operator: 
   Pairing& operator=(const Pairing &rhs);
 
+  void initShared();
+  const GLVParams *checkGLV();
+  void initGLV();
+  void clearGLV();
+
   pairing_t e;
   bool pairingPresent;
+  GLVParams *glv;
+  bool glvChecked;//Whether initGLV() has run; guarded by glvLock
+  pthread_mutex_t glvLock;
 };
 
 #endif
@@ -45,6 +45,12 @@ int main(int argc, char **argv)
 	cout<<"Inverse, Square works"<<endl;
   else
 	cout<<"Inverse, Square does not work."<<endl;
+  //Exercises the GLV path when the parameter file is a type F curve
+  Zr t(e,true);
+  if((p^(r+t)) == (p^r)*(p^t) && ((p^r)^t) == (p^(r*t)))
+	cout<<"G1 exponentiation works"<<endl;
+  else
+	cout<<"G1 exponentiation does not work."<<endl;
   G1 a;
   a = p;
   p.dump(stdout,"p is ") ;
@@ -0,0 +1,59 @@
+//Checks G1 exponentiation by GLV against plain element_pow_zn, on a curve
+//that has the endomorphism (type F, q = r = 1 mod 3).
+//Usage: glvtest [paramfile [rounds]], by default f.param and 1000 rounds.
+#include <iostream>
+#include <stdlib.h>
+#include "PBC.h"
+
+using namespace std;
+
+//g^k without GLV
+static bool matches_plain(const G1 &g, const Zr &k)
+{
+  G1 fast = g^k;
+  element_t plain;
+  element_init_same_as(plain, *(element_t*)&g.getElement());
+  element_pow_zn(plain, *(element_t*)&g.getElement(), *(element_t*)&k.getElement());
+  bool same = !element_cmp(plain, *(element_t*)&fast.getElement());
+  element_clear(plain);
+  return same;
+}
+
+int main(int argc, char **argv)
+{
+  const char *paramFileName = (argc > 1) ? argv[1] : "f.param";
+  int rounds = (argc > 2) ? atoi(argv[2]) : 1000;
+  FILE *paramFile = fopen(paramFileName, "r");
+  if (paramFile == NULL) {
+    cerr<<"Can't open the parameter file " << paramFileName << "\n";
+    cerr<<"Usage: " << argv[0] << " [paramfile [rounds]]\n";
+    return 1;
+  }
+  Pairing e(paramFile);
+  fclose(paramFile);
+
+  G1 g(e, false);
+  if (!Pairing::getGLV(g.getElement())) {
+    cout<<"No GLV endomorphism for " << paramFileName << endl;
+    return 1;
+  }
+
+  int failures = 0;
+  //Exponents whose halves are at the edges of the decomposition
+  long edges[] = {0, 1, 2, 3, -1, -2};
+  for (size_t i = 0; i < sizeof(edges)/sizeof(edges[0]); ++i)
+    if (!matches_plain(g, Zr(e, edges[i]))) {
+      cout<<"Exponent " << edges[i] << " differs" << endl;
+      ++failures;
+    }
+  for (int i = 0; i < rounds; ++i) {
+    G1 h(e, false);
+    Zr k(e, true);
+    if (!matches_plain(h, k)) {
+      k.dump(stdout, "Differs for exponent ", 10);
+      ++failures;
+    }
+  }
+  cout<<rounds<<" random exponents: "<<failures<<" failures"<<endl;
+  return failures ? 1 : 0;
+}
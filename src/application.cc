@@ -56,7 +56,8 @@ Application(SystemType systemtype,
   //							 systemtype == CLIENT ? "Client" :
   //							 "Unknown system type") << "\n";
   
-  if (systemtype != BLS_CLIENT) {
+  // Port 0: a simulated node, which has no sockets
+  if (systemtype != BLS_CLIENT && listen_port != 0) {
   	// Make the listening socket
 	  //read the historical data to decide the timeout function
 
@@ -98,8 +99,22 @@ Application(SystemType systemtype,
   } else listenfd = -1;
   // On what fd will user commands show up?
   userfd = 0;
+
+  // Everything we wait on goes through the reactor
+  Reactor &reactor = buddyset.get_reactor();
+  if (listenfd >= 0) reactor.add(listenfd);
+  reactor.add(userfd);
+  reactor.add(sigPool.get_fd());
   
   buddyset.init_contact_list(contactlistfile);
+
+  // Nodes on this host marked " S" in the contact list reach us through
+  // shared memory; the link is set up over a unix socket
+  localfd = -1;
+  if (listenfd >= 0 && buddyset.is_local(buddyset.get_my_id())) {
+	localfd = shm_listen(listen_port);
+	if (localfd >= 0) reactor.add(localfd);
+  }
   
   //Intialzie the active user's list
   map<BuddyID, ContactEntry> buddy_list;
@@ -114,35 +129,23 @@ Application(SystemType systemtype,
 //BuddyID& buddyID returns ID for the sender 
 Message *Application::get_next_message(BuddyID& buddyID, BuddyID selfID)
 {
+    Reactor &reactor = buddyset.get_reactor();
+    Message *replayed = get_replayed(buddyID);
+    if (replayed) return replayed;
     while (1) {
-		// Figure out where our next message is coming from
-		int maxfd = -1;
-		fd_set rfd;
-
-		FD_ZERO(&rfd);
-
-		// UI input
-		if (userfd >= 0) {
-	    		FD_SET(userfd, &rfd);
-	   	 	if (userfd > maxfd) maxfd = userfd;
-		}
-
-		// New incoming socket connections
-		if (listenfd >= 0) {
-	    		FD_SET(listenfd, &rfd);
-	   	 	if (listenfd > maxfd) maxfd = listenfd;
-		}
-
-		// Messages on existing connections
-		int buddymaxfd = buddyset.set_fds(&rfd);
-		if (buddymaxfd > maxfd) maxfd = buddymaxfd;
-
 		// See if a timer message will expire soon
 		struct timeval timer;
+		int timeout = -1;
 
 		// Get performance measurements
 		//measure_now();
-		int res = select(maxfd+1, &rfd, NULL, NULL, Timer::time_to_next(&timer));
+		// Only poll if messages already read are waiting
+		if (buddyset.has_buffered()) {
+			timeout = 0;
+		} else if (Timer::time_to_next(&timer)) {
+			timeout = timer.tv_sec * 1000 + (timer.tv_usec + 999) / 1000;
+		}
+		int res = reactor.wait(timeout);
 
 		if (res == 0) {
 		    // See if a TimerMessage is ready to fire
@@ -150,11 +153,38 @@ Message *Application::get_next_message(BuddyID& buddyID, BuddyID selfID)
 	    		if (tmsg) return tmsg;
 		}
 
-		// Figure out what happened
-		if (userfd >= 0 && FD_ISSET(userfd, &rfd)) {
+		// Figure out what happened. Socket I/O is done here; the UI and
+		// sigPool events are taken one at a time below, and the reactor
+		// reports any left over again on the next wait.
+		bool userReady = false, sigReady = false;
+		for (int i = 0; i < res; i++) {
+			int fd = reactor.get_fd(i);
+			if (fd == userfd) {
+				userReady = true;
+			} else if (fd == sigPool.get_fd()) {
+				sigReady = true;
+			} else if (fd == listenfd) {
+		    		sockaddr_in sin;
+	    			socklen_t sinlen = sizeof(sin);
+
+	    			int newfd = accept(listenfd, (sockaddr *)&sin, &sinlen);
+	    			if (newfd >= 0) {
+					buddyset.add_buddy_fd(newfd);
+				}
+			} else if (fd == localfd) {
+				int newfd = accept(localfd, NULL, NULL);
+				if (newfd >= 0) buddyset.add_buddy_fd(newfd, true);
+			} else {
+				buddyset.handle_event(fd, reactor.readable(i),
+					reactor.writable(i));
+			}
+		}
+
+		if (userReady) {
 	    		UserMessage *usermessage = UserMessage::read_message();
 	    	if (usermessage == NULL) {
 				//cerr << "User input closed\n";
+				reactor.remove(userfd);
 				userfd = -1;
 				close(userfd);
 	    	} else {
@@ -162,59 +192,79 @@ Message *Application::get_next_message(BuddyID& buddyID, BuddyID selfID)
 	    	}
 		}
 
-		if (listenfd >= 0 && FD_ISSET(listenfd, &rfd)) {
-		    	sockaddr_in sin;
-	    		socklen_t sinlen = sizeof(sin);
-
-	    		int newfd = accept(listenfd, (sockaddr *)&sin, &sinlen);
-	    		if (newfd >= 0) {
-				buddyset.add_buddy_fd(newfd);
-			}
+		if (sigReady) {
+			Message *checkedmsg = sigPool.get_done(buddyID);
+			if (checkedmsg) return checkedmsg;
 		}
 
-		Buddy *foundbuddy = buddyset.find_set_fd(&rfd);
+		Buddy *foundbuddy = buddyset.next_buffered();
 
 		if (foundbuddy) {
-
-	   	 	if (foundbuddy->got_cert() == 0) {
-
-				foundbuddy->read_cert();
-
-				if (foundbuddy->got_cert() == 0) {
-				    	// Closed socket; get rid of this buddy
-					//cerr<<"Deleting(1) buddy "<<  foundbuddy->get_id() << " from " << selfID <<endl;
-			    		buddyset.close_buddy(foundbuddy);
-				} else {
-				    	buddyset.add_buddy_id(foundbuddy);
-				}
-	    	} else {
+			SigJob *job = new SigJob;
 			try {
-			    Message *newmsg = NetworkMessage::read_message(systemtype,foundbuddy);
+			    Message *newmsg = NetworkMessage::read_message(systemtype,foundbuddy,job);
 			    if (newmsg == NULL) {
 				// Closed socket; 
 			        //cerr<<"Deleting(2) buddy "<<  foundbuddy->get_id()<<" on fd "<<foundbuddy->get_fd()<<endl;
 					buddyset.close_buddy(foundbuddy);
+			    } else if (job->size()) {
+				// Handed back by sigPool once the signatures are checked
+				sigPool.submit(job, newmsg, foundbuddy->get_id());
+				job = NULL;
 			    } else {
+			    	delete job;
 			    	buddyID = foundbuddy->get_id();
 			    	return newmsg;
 		    	}
 			} catch (InvalidMessageException e) {
 		    	cerr<<"Invalid message received from buddy id "<<foundbuddy->get_id() << "\n";
 			}
-	    	}
+			delete job;
 		}// else cerr<<"foundbuddy is null\n";
     }
 }
 
+Message *Application::get_replayed(BuddyID& buddyID)
+{
+    if (replayQueue.empty()) return NULL;
+    buddyID = replayQueue.front().first;
+    Message *msg = replayQueue.front().second;
+    replayQueue.pop_front();
+    return msg;
+}
+
+Message *Application::deliver(BuddyID buddyID, const string &msgstr)
+{
+    Buddy *sender = buddyset.find_buddy_id(buddyID);
+    if (!sender || msgstr.size() < NetworkMessage::msgIDLength + NetworkMessage::headerLength)
+	return NULL;
+    int g_recv_ID = (msgstr[0] << 24) | (((msgstr[1]) << 16) & 0x00ffffff) |
+	(((msgstr[2]) << 8) & 0x0000ffff) | (msgstr[3] & 0x000000ff);
+    try {
+	// Without a job the signatures are checked right here
+	return NetworkMessage::parse_message(systemtype, sender,
+		msgstr.substr(NetworkMessage::msgIDLength), g_recv_ID);
+    } catch (InvalidMessageException &e) {
+	cerr<<"Invalid message received from buddy id "<<buddyID << "\n";
+    }
+    return NULL;
+}
+
+void Application::set_bls_record(BuddyID buddyID, const string &record)
+{
+    Buddy *buddy = buddyset.find_buddy_id(buddyID);
+    if (buddy) buddy->set_bls_record((const unsigned char *)record.data(), record.size());
+}
+
 void Application::measure_init()
 {
-    gettimeofday(&start_time, NULL);
+    Timer::now(&start_time);
 }
 
 void Application::measure_now()
 {
 	struct timeval now;
-	gettimeofday(&now, NULL);
+	Timer::now(&now);
 
 	long realms = (now.tv_sec - start_time.tv_sec) * 1000 +
 		(now.tv_usec - start_time.tv_usec) / 1000;
@@ -244,7 +294,7 @@ unsigned long Application::get_time_diff(int t, unsigned long incre){
 	if (timeout_times == 1) {
 		// This is the first time of timeout
 		struct timeval now;
-		gettimeofday(&now, NULL);
+		Timer::now(&now);
 
 		last_timeout = (now.tv_sec - start_time.tv_sec) * 1000 +
 			(now.tv_usec - start_time.tv_usec) / 1000;
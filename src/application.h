@@ -23,11 +23,13 @@
 #include <netinet/in.h>
 #include <sys/time.h>
 #include <map>
+#include <deque>
 #include <vector>
 #include "systemparam.h"
 #include "buddyset.h"
 #include "message.h"
 #include "io.h"
+#include "sigpool.h"
 
 using namespace std;
 
@@ -43,10 +45,21 @@ class Application {
 	Phase ph;
 
 	int userfd, listenfd;
+	int localfd;//Unix socket co-located nodes connect to, or -1
+	//Checks the signatures bundled in large messages while others go on
+	SigPool sigPool;
 
 	Message *get_next_message(BuddyID& buddyID, BuddyID selfID);
 	//for network messages, buddy returns the sender of the message 
 
+	//Have get_next_message return msg (from buddyID) again, ahead of new
+	//messages; for messages that had to wait for something
+	void replay(BuddyID buddyID, Message *msg) {
+		replayQueue.push_back(make_pair(buddyID, msg));
+	}
+	deque <pair<BuddyID, Message*> > replayQueue;
+
+
   Application(SystemType systemtype, 
 				const char *pairingparamfile,
 				const char *sysparamfile, in_addr_t listen_addr, 
@@ -63,6 +76,20 @@ class Application {
     public:
 	void measure_init();
 	void measure_now();
+
+	//For running in a simulation (simbus.h) rather than in run(): start()
+	//does what comes before the message loop, and handle() what is done
+	//for each message, which it deletes
+	virtual void start() {}
+	virtual void handle(Message *msg, BuddyID buddyID) { delete msg; }
+	virtual bool finished() const { return false; }
+	void attach_bus(class SimBus *bus) { buddyset.set_bus(bus); }
+	//Parse msgstr from buddyID as handed over by the bus; NULL if invalid
+	Message *deliver(BuddyID buddyID, const string &msgstr);
+	//The next message put back with replay(), or NULL
+	Message *get_replayed(BuddyID &buddyID);
+	const string &get_bls_record() const { return buddyset.get_bls_record(); }
+	void set_bls_record(BuddyID buddyID, const string &record);
 };
 
 
@@ -0,0 +1,102 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include <gcrypt.h>
+#include <istream>
+#include "bls.h"
+#include "io.h"
+
+static string to_hex(const string& s){
+	static const char digits[] = "0123456789abcdef";
+	string hex;
+	for (size_t i = 0; i < s.size(); ++i){
+		unsigned char b = s[i];
+		hex.push_back(digits[b >> 4]);
+		hex.push_back(digits[b & 0xf]);
+	}
+	return hex;
+}
+
+static bool from_hex(const string& hex, string& out){
+	if (hex.size() % 2) return false;
+	out.clear();
+	for (size_t i = 0; i < hex.size(); i += 2){
+		unsigned int b;
+		if (sscanf(hex.substr(i,2).c_str(), "%2x", &b) != 1) return false;
+		out.push_back((char)b);
+	}
+	return true;
+}
+
+bool bls_verify(const SystemParam& sys, const G1& publicKey,
+				const string& msg, const G1& signature){
+	const Pairing& e = sys.get_Pairing();
+	G1 msgHashG1;
+	hash_msg(msgHashG1, msg, e);
+	return e(sys.get_U(), signature) == e(publicKey, msgHashG1);
+}
+
+bool bls_batch_verify(const SystemParam& sys, const G1& publicKey,
+					  const vector <string>& msgs, const vector <G1>& signatures){
+	if (msgs.size() != signatures.size()) return false;
+	if (msgs.empty()) return true;
+	if (msgs.size() == 1) return bls_verify(sys, publicKey, msgs[0], signatures[0]);
+	
+	const Pairing& e = sys.get_Pairing();
+	//Random nonzero 63 bit weights; a bad signature survives with probability 2^-63
+	vector <Zr> weights;
+	vector <G1> hashes;
+	for (size_t i = 0; i < msgs.size(); ++i){
+		unsigned long long r;
+		gcry_create_nonce(&r, sizeof(r));
+		weights.push_back(Zr(e, (long)((r >> 1) | 1)));
+		G1 msgHashG1;
+		hash_msg(msgHashG1, msgs[i], e);
+		hashes.push_back(msgHashG1);
+	}
+	G1 sigSum = G1::multiexp(signatures, weights);
+	G1 hashSum = G1::multiexp(hashes, weights);
+	return e(sys.get_U(), sigSum) == e(publicKey, hashSum);
+}
+
+size_t read_signature_file(const SystemParam& sys, istream& in,
+						   vector <string>& msgs, vector <G1>& signatures){
+	size_t bad = 0;
+	string msgHex, sigHex;
+	while (in >> msgHex >> sigHex){
+		string msg, sig;
+		if (!from_hex(msgHex, msg) || !from_hex(sigHex, sig)) {++bad; continue;}
+		try {
+			const unsigned char *buf = (const unsigned char*)sig.data();
+			size_t len = sig.size();
+			G1 signature;
+			read_G1(buf, len, signature, sys.get_Pairing());
+			if (!signature.isElementPresent() || len) {++bad; continue;}
+			msgs.push_back(msg);
+			signatures.push_back(signature);
+		} catch (...) {++bad;}
+	}
+	return bad;
+}
+
+string signature_line(const string& msg, const G1& signature){
+	string sig;
+	write_G1(sig, signature);
+	return to_hex(msg) + " " + to_hex(sig);
+}
@@ -0,0 +1,47 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#ifndef __BLS_H__
+#define __BLS_H__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "systemparam.h"
+
+using namespace std;
+
+//Check one signature: e(U, sig) == e(PK, H(msg))
+bool bls_verify(const SystemParam& sys, const G1& publicKey,
+				const string& msg, const G1& signature);
+
+//Check many signatures under the same key with two pairings:
+//e(U, prod sig_i^r_i) == e(PK, prod H(msg_i)^r_i) for random odd 63 bit
+//r_i, each product taken with one multiexp.
+//A false result means at least one signature is bad.
+bool bls_batch_verify(const SystemParam& sys, const G1& publicKey,
+					  const vector <string>& msgs, const vector <G1>& signatures);
+
+//Read "<message hex> <signature hex>" lines as written by the BLS client
+//Returns the number of lines that could not be parsed
+size_t read_signature_file(const SystemParam& sys, istream& in,
+						   vector <string>& msgs, vector <G1>& signatures);
+
+string signature_line(const string& msg, const G1& signature);
+#endif
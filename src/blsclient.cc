@@ -22,13 +22,14 @@
 #include "buddyset.h"
 #include "exceptions.h"
 #include "lagrange.h"
+#include "bls.h"
 
 class BLSClient : public Application {
 public:
     BLSClient(const char *pairingfile, const char *sysparamfile, const char *certfile, 
 	    const char *keyfile, const char *contactlistfile, Phase ph):
 	Application(BLS_CLIENT, pairingfile, sysparamfile, 0, 0, certfile, keyfile, contactlistfile, ph),
-	msgLog("message.log",ios::out)
+	msgLog("message.log",ios::out), lagrange(sysparams.get_Pairing())
     {
     //Generate a random public/pivate key pair
     	clientPrivateKey = Zr(sysparams.get_Pairing(),true);
@@ -50,6 +51,7 @@ private:
   G1 msgHashG1; //Message hash
   //map<unsigned int, KeyShares> sharesmap;  // Map from phase to KeyShares  
   	fstream msgLog;
+  LagrangeAtZero lagrange;//Coefficients for the first 2t+1 shares
 };
 
 int BLSClient::run()
@@ -91,13 +93,40 @@ int BLSClient::run()
 				G1 mySignature = msgHashG1^clientPrivateKey;
 				//cerr<<"Message is"<<msg<<endl;
 				BLSSignatureRequestMessage signRequest(buddyset, ph, msg,mySignature);
-				signatureShares.clear(); validSignature = false;		
+				signatureShares.clear(); lagrange.clear(); validSignature = false;		
 				vector<NodeID>::const_iterator iter;//For the active nodes list					
 				for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
 					buddyset.send_message(*iter, signRequest);
 				}
 							
 			} 
+			break;
+			case VERIFY_SIGNATURES: {
+				BLSVerifyUserMessage *verify = static_cast<BLSVerifyUserMessage*>(um);
+				if (!quorumPublicKey.isElementPresent()) {
+					cerr << "Quorum public key is not known yet\n";
+					break;
+				}
+				ifstream in(verify->filename.c_str());
+				if (!in) {
+					cerr << "Can't open " << verify->filename << "\n";
+					break;
+				}
+				vector <string> msgs; vector <G1> signatures;
+				size_t unreadable = read_signature_file(sysparams, in, msgs, signatures);
+				if (unreadable) cerr << unreadable << " unreadable lines in " << verify->filename << "\n";
+				measure_init();
+				if (bls_batch_verify(sysparams, quorumPublicKey, msgs, signatures)) {
+					cerr << "All " << msgs.size() << " signatures verified\n";
+				} else {
+					//Find the bad ones one by one
+					for (size_t i = 0; i < msgs.size(); ++i)
+						if (!bls_verify(sysparams, quorumPublicKey, msgs[i], signatures[i]))
+							cerr << "Signature " << i + 1 << " is invalid\n";
+				}
+				measure_now();
+			}
+			break;
 			default:
 			    {
 				cerr << "Unknown user command\n";
@@ -128,8 +157,6 @@ int BLSClient::run()
 			case BLS_SIGNATURE_RESPONSE:
 			{
 				BLSSignatureResponseMessage *signResponse = static_cast<BLSSignatureResponseMessage*>(nm);
-				if (buddyID == 2 || buddyID == 3 || buddyID == 5 || buddyID == 8 || buddyID == 17 || buddyID == 24 || buddyID == 35|| buddyID == 32 || buddyID == 33 || buddyID == 37 || buddyID == 38 || buddyID == 28 || buddyID == 30||  	buddyID == 4 || buddyID == 6 || buddyID == 7 || buddyID == 9 || buddyID == 10 || buddyID == 11 || buddyID == 12 || buddyID == 13 || buddyID == 18 || buddyID == 20 || buddyID == 21 || buddyID == 22 || buddyID == 23 || buddyID == 27 || buddyID == 29 || buddyID ==31 || buddyID == 34 || buddyID == 36 || buddyID == 40)
-					continue;
 				cerr << "Received BLS Siganture share from " << buddyID <<endl;
 				if(ph > signResponse->ph) {
 					//TODO: Actual system need not to display the following messages.
@@ -138,25 +165,23 @@ int BLSClient::run()
 					//TODO: Actual system need not to display the following messages.
 			  		cerr<<"Phase for  BLS signature response message"<<signResponse->ph<<" is newerolder than the current phase "<<ph<<endl;							 
 				} else {					
-					signatureShares.insert(make_pair(buddyID, signResponse->signatureShare));
+					//Work on the coefficients as the shares come in
+					if (signatureShares.insert(make_pair(buddyID, signResponse->signatureShare)).second
+						&& lagrange.size() < 2 * sysparams.get_t() + 1u)
+						lagrange.add(buddyID);
 					if (((NodeID)signatureShares.size() == 2 * sysparams.get_t() + 1) && !signature.isElementPresent()){
 					    // We can now construct the signature
 					    //cerr << "Constructing the Signature\n";					    				    
-					    //Make an array of the indices and shares;
-						vector <Zr> indices; vector <G1> shares;
 						const Pairing& e = sysparams.get_Pairing();
+						vector <G1> shares;
 						for(map<NodeID, G1>::const_iterator it = signatureShares.begin();
-							 it != signatureShares.end(); ++it){						
-							indices.push_back(Zr(e,(signed long)it->first));
+							 it != signatureShares.end(); ++it)
 							shares.push_back(it->second);
-						}						
-						//pushing evaluation at zero
-						Zr alpha(e,(long)0);
-						vector<Zr> coeffs = lagrange_coeffs(indices, alpha);
-						G1 tempSignature = lagrange_apply(coeffs, shares);
+						G1 tempSignature = lagrange_apply(lagrange.coeffs(), shares);
 						measure_init();
 						if(e(sysparams.get_U(),tempSignature) == e(quorumPublicKey,msgHashG1)){
-						  cerr << "\n*** CORRECT!\n\n";						  
+						  cerr << "\n*** CORRECT!\n\n";
+						  cout << signature_line(msg, tempSignature) << endl;
 						} else {						
 						  cerr << "\n*** DIFFERENT!\n\n";
 						  //Send a Wrong Signatures Message						  
@@ -0,0 +1,79 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+//Checks for BLS signatures as the client verifies them: a signature holds
+//for its own message only, singly and in a batch.
+//Usage: blstest, with pairing.param and system.param in the current
+//directory.
+
+#include <iostream>
+#include "bls.h"
+#include "io.h"
+
+static long failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	if (!ok) {
+		cout << "FAILED: " << what << endl;
+		++failures;
+	}
+}
+
+static G1 sign(const SystemParam &sys, const Zr &key, const string &msg)
+{
+	G1 msgHash;
+	hash_msg(msgHash, msg, sys.get_Pairing());
+	return msgHash^key;
+}
+
+int main()
+{
+	SystemParam sys("pairing.param", "system.param");
+	const Pairing &e = sys.get_Pairing();
+	Zr key(e, true);
+	G1 publicKey = sys.get_U()^key;
+
+	string msg("abcdef"), sameStart("abXYZ"), empty, oneByte("a");
+	G1 sig = sign(sys, key, msg);
+	check(bls_verify(sys, publicKey, msg, sig), "good signature");
+	check(!bls_verify(sys, publicKey, sameStart, sig),
+		  "signature on a message with the same first two bytes");
+	check(!bls_verify(sys, publicKey, msg.substr(0, 2), sig),
+		  "signature on the first two bytes alone");
+	check(bls_verify(sys, publicKey, empty, sign(sys, key, empty)),
+		  "signature on an empty message");
+	check(bls_verify(sys, publicKey, oneByte, sign(sys, key, oneByte)),
+		  "signature on a one byte message");
+	check(!bls_verify(sys, publicKey, oneByte, sign(sys, key, empty)),
+		  "empty message signature on a one byte message");
+
+	vector <string> msgs;
+	vector <G1> sigs;
+	for (int i = 0; i < 8; ++i) {
+		string m("ab message ");
+		m.push_back('0' + i);
+		msgs.push_back(m);
+		sigs.push_back(sign(sys, key, m));
+	}
+	check(bls_batch_verify(sys, publicKey, msgs, sigs), "good batch");
+	msgs[5] = "ab forged";
+	check(!bls_batch_verify(sys, publicKey, msgs, sigs),
+		  "batch with a message sharing the first two bytes");
+
+	cout << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
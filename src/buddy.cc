@@ -17,7 +17,6 @@
 
 
 
-#include <pthread.h>
 #include <iomanip>
 #include <iostream>
 #include <sys/time.h>
@@ -26,24 +25,32 @@
 #include <fstream>
 #include <iomanip>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <algorithm>
 #include "buddyset.h"
 #include "buddy.h"
+#include "io.h"
+#include "ed25519.h"
+#include "dsa.h"
+#include "simbus.h"
 
 using namespace std;
 
 Buddy::Buddy(BuddySet &buddyset, int fd) :
-	buddyset(buddyset), fd(fd), thread_is_running(false), id(NODEID_NONE),
-    is_server(1), has_cert(0), buddy_dsa_pubkey(NULL)
+	buddyset(buddyset), fd(fd), id(NODEID_NONE),
+    is_server(1), has_cert(0), buddy_dsa_pubkey(NULL), has_bls_pubkey(false),
+    inpos(0), inlen(0), complete(0), want(0), shm(NULL), eof(false), outpos(0), connecting(false), watching_out(false)
 {
-	pthread_mutex_init(&mutex, NULL);
     //cerr << "Received new buddy on fd " << fd << "\n";
 }
 
 Buddy::Buddy(BuddySet &buddyset, int fd, NodeID id) :
-    buddyset(buddyset), fd(fd), thread_is_running(false), id(id),
-    is_server(0), has_cert(0), buddy_dsa_pubkey(NULL)
+    buddyset(buddyset), fd(fd), id(id),
+    is_server(0), has_cert(0), buddy_dsa_pubkey(NULL), has_bls_pubkey(false),
+    inpos(0), inlen(0), complete(0), want(0), shm(NULL), eof(false), outpos(0), connecting(false), watching_out(false)
 {
-	pthread_mutex_init(&mutex, NULL);
     //cerr << "Contacting new buddy id " << id << " on fd " << fd << "\n";
 
     // This will eventually turn into actual TLS.  For now, we just
@@ -56,17 +63,6 @@ const SystemParam &Buddy::get_param() const
     return buddyset.get_param();
 }
 
-void Buddy::send_cert(int usefd) const
-{
-    if (usefd < 0) usefd = fd;
-    if (usefd < 0) return;
-    //cerr << "Sending cert\n";
-    const string &cert = buddyset.get_cert();
-    unsigned int len = htonl(cert.size());
-    write(usefd, (char *)&len, 4);
-    write(usefd, cert.data(), cert.size());
-    //cerr << "Sent cert\n";
-}
 void Buddy::set_cert(string cert)
 {
     buddy_dsa_pubkey = NULL;
@@ -77,11 +73,28 @@ void Buddy::set_cert(string cert)
     certdatum.data = (unsigned char*)cert.data();
     certdatum.size = cert.length();
     gnutls_x509_crt_import(buddy_cert, &certdatum, GNUTLS_X509_FMT_PEM);
+    set_pubkey(buddy_cert);
+    gnutls_x509_crt_deinit(buddy_cert);
+
+    has_cert = 1;	
+}
+
+// Take the DSA or Ed25519 public key out of a cert
+void Buddy::set_pubkey(gnutls_x509_crt_t buddy_cert)
+{
+    if (gnutls_x509_crt_get_pk_algorithm(buddy_cert, NULL) == GNUTLS_PK_EDDSA_ED25519) {
+	gnutls_ecc_curve_t curve;
+	gnutls_datum_t xd, yd;
+	gnutls_x509_crt_get_pk_ecc_raw(buddy_cert, &curve, &xd, &yd);
+	ed25519_pubkey.assign((char *)xd.data, xd.size);
+	gnutls_free(xd.data);
+	gnutls_free(yd.data);
+	return;
+    }
 
     // Extract the params from the pubkey
     gnutls_datum_t pd, qd, gd, yd;
     gnutls_x509_crt_get_pk_dsa_raw(buddy_cert, &pd, &qd, &gd, &yd);
-    gnutls_x509_crt_deinit(buddy_cert);
 
     // Construct libgcrypt MPIs from the pieces
     gcry_mpi_t p, q, g, y;
@@ -101,12 +114,6 @@ void Buddy::set_cert(string cert)
     gcry_mpi_release(q);
     gcry_mpi_release(g);
     gcry_mpi_release(y);
-
-    has_cert = 1;	
-}
-
-void Buddy::destroy_mutex() {
-	pthread_mutex_destroy(&mutex);
 }
 
 void Buddy::get_cert()
@@ -123,12 +130,13 @@ void Buddy::get_cert()
     len = ntohl(len);
 
     // Read the actual cert (in PEM format)
-    unsigned char certbuf[len];
+    if (inlen - inpos < len) return;
+    vector<unsigned char> certbuf(len + 1);
     //cerr << "Waiting for cert\n";
-    if (read_record(certbuf, len) != (int)len) return;
+    if (read_record(&certbuf[0], len) != (int)len) return;
     //cerr << "Got cert\n";
     gnutls_datum_t certdatum;
-    certdatum.data = certbuf;
+    certdatum.data = &certbuf[0];
     certdatum.size = len;
     gnutls_x509_crt_import(buddy_cert, &certdatum, GNUTLS_X509_FMT_PEM);
 
@@ -148,41 +156,61 @@ void Buddy::get_cert()
 	cerr << "Unknown ID received from buddy\n";
     }
 
-    // Extract the params from the pubkey
-    gnutls_datum_t pd, qd, gd, yd;
-    gnutls_x509_crt_get_pk_dsa_raw(buddy_cert, &pd, &qd, &gd, &yd);
+    set_pubkey(buddy_cert);
     gnutls_x509_crt_deinit(buddy_cert);
 
-    // Construct libgcrypt MPIs from the pieces
-    gcry_mpi_t p, q, g, y;
-    gcry_mpi_scan(&p, GCRYMPI_FMT_USG, pd.data, pd.size, NULL);
-    gcry_mpi_scan(&q, GCRYMPI_FMT_USG, qd.data, qd.size, NULL);
-    gcry_mpi_scan(&g, GCRYMPI_FMT_USG, gd.data, gd.size, NULL);
-    gcry_mpi_scan(&y, GCRYMPI_FMT_USG, yd.data, yd.size, NULL);
-    gnutls_free(pd.data);
-    gnutls_free(qd.data);
-    gnutls_free(gd.data);
-    gnutls_free(yd.data);
-
-    // Build the sexp holding the public DSA key
-    gcry_sexp_build(&buddy_dsa_pubkey, NULL,
-	    "(public-key(dsa(p%m)(q%m)(g%m)(y%m)))", p, q, g, y);
-    gcry_mpi_release(p);
-    gcry_mpi_release(q);
-    gcry_mpi_release(g);
-    gcry_mpi_release(y);
+    if (get_param().use_certificates()) read_bls_pubkey();
 
     has_cert = 1;
+    // Messages may have come in behind the cert
+    frame();
 
     //if (is_server) {
 	//	send_cert();
     //}
 }
 
+// Read the BLS key record that follows the cert. The key is only taken
+// if the cert's DSA key signed it and the proof of possession checks out.
+void Buddy::read_bls_pubkey()
+{
+    unsigned int len;
+    if (read_record((unsigned char *)&len, 4) != 4) return;
+    len = ntohl(len);
+    if (inlen - inpos < len) return;
+    vector<unsigned char> recordbuf(len + 1);
+    unsigned char *record = &recordbuf[0];
+    if (read_record(record, len) != (int)len) return;
+    set_bls_record(record, len);
+}
+
+// Take the BLS key from a record as sent after the cert
+void Buddy::set_bls_record(const unsigned char *record, size_t len)
+{
+    const Pairing &e = get_param().get_Pairing();
+    size_t eltlen = e.getElementSize(Type_G1, true);
+    if (len != 2*eltlen + cert_sig_size()) return;
+    if (cert_verify(record, eltlen, record + 2*eltlen) < 0) {
+	cerr << "Bad BLS key signature from buddy " << id << "\n";
+	return;
+    }
+    G1 pubkey(e, record, eltlen, true);
+    G1 pop(e, record + eltlen, eltlen, true);
+    G1 popHash;
+    hash_signed(popHash, record, eltlen, e, "DKG node BLS key possession");
+    if (!(e(get_param().get_U(), pop) == e(pubkey, popHash))) {
+	cerr << "Bad BLS key possession proof from buddy " << id << "\n";
+	return;
+    }
+    bls_pubkey = pubkey;
+    has_bls_pubkey = true;
+}
+
 Buddy::~Buddy()
 {
     cerr << "Destroying buddy on fd " << fd << "\n";
     gcry_sexp_release(buddy_dsa_pubkey);
+    delete shm;
 }
 
 void Buddy::close_fd()
@@ -190,145 +218,347 @@ void Buddy::close_fd()
     if (fd < 0) return;
     close(fd);
     fd = -1;
+
+    // Anything half read or half written belonged to the old connection
+    inbuf.clear();
+    inpos = inlen = complete = want = 0;
+    delete shm;
+    shm = NULL;
+    eof = false;
+    handshake.clear();
+    outpos = 0;
+    msgqueue.restart();
+    connecting = false;
+    watching_out = false;
 }
 
-int Buddy::read_record(unsigned char *buffer, size_t len) const
+#define MSG_HEADER_LENGTH 9	// 4 byte ID, 1 byte type, 4 byte length
+#define MSG_LENGTH_START 5
+
+static size_t frame_length(const char *frame)
 {
-    if (fd < 0) return 0;
+    const unsigned char *header = (const unsigned char *)frame;
+    return MSG_HEADER_LENGTH + (((size_t)header[MSG_LENGTH_START] << 24) + 
+	(header[MSG_LENGTH_START+1] << 16) + 
+	(header[MSG_LENGTH_START+2] << 8) + 
+	header[MSG_LENGTH_START+3]);
+}
 
-    int res = 0;
-    while (len > 0) {
-	int piece = read(fd, buffer, len);
-	if (piece < 0) return piece;
-	if (piece == 0) return res;
-	buffer += piece;
-	len -= piece;
-	res += piece;
+int Buddy::fill()
+{
+    if (fd < 0) return -1;
+    if (shm) {
+	if (local_event() < 0) eof = true;
+	int total = shm->is_up() ? read_input() : 0;
+	return eof ? -1 : total;
     }
-    return res;
+    return read_input();
 }
 
-int Buddy::read_messagestr(string &msgstr) const
+// For a co-located buddy, the socket only carries the link setup, and
+// tells us when the buddy is gone
+int Buddy::local_event()
 {
-    int IDLength = 4;
-    int lenLength = 4;
-    int typeLength = 1;
-    int headerLength = IDLength + lenLength + typeLength;
-    unsigned char header[headerLength];
+    if (!shm->is_up()) {
+	int res = shm->answer(fd);
+	if (res <= 0) return res;
+	buddyset.add_notify_fd(this);
+	connecting = false;
+	flush();
+	return 0;
+    }
+    char buf[64];
+    ssize_t res = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (res == 0) return -1;
+    if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+    return 0;
+}
 
-    size_t res = read_record(header, headerLength);
-    if (res < headerLength) return -1;
+void Buddy::notified()
+{
+    shm->clear();
+    flush();
+    read_input();
+}
 
-    int lengthFieldStart = IDLength + typeLength;
-    unsigned int len = (header[lengthFieldStart] << 24) + 
-	(header[lengthFieldStart+1] << 16) + 
-	(header[lengthFieldStart+2] << 8) + 
-	header[lengthFieldStart+3];
+// Read what the socket or ring has, <0 once the socket is closed
+int Buddy::read_some(char *buf, size_t len)
+{
+    if (shm) {
+	size_t got = shm->read(buf, len);
+	if (got == 0 && !shm->sleep()) got = shm->read(buf, len);
+	return got;
+    }
+    while (1) {
+	int piece = read(fd, buf, len);
+	if (piece > 0) return piece;
+	if (piece < 0 && errno == EINTR) continue;
+	if (piece < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+	return -1;
+    }
+}
 
-    unsigned char message[len+headerLength];
-    memmove(message, header, headerLength);
-    res = read_record(message+headerLength, len);
-    if (res < len) return -1;
-    msgstr.assign((char *)message, len+headerLength);
+int Buddy::read_input()
+{
+    // Move what has not been taken yet to the front
+    if (inpos) {
+	memmove(&inbuf[0], inbuf.data() + inpos, inlen - inpos);
+	inlen -= inpos;
+	complete = complete > inpos ? complete - inpos : 0;
+	if (want) want -= inpos;
+	inpos = 0;
+    }
+    if (inlen == 0 && inbuf.size() > BUDDY_READ_LIMIT) string().swap(inbuf);
+
+    int total = 0, res = 0;
+    while (total < BUDDY_READ_LIMIT) {
+	make_room();
+	size_t room = inbuf.size() - inlen;
+	if (room > (size_t)(BUDDY_READ_LIMIT - total)) room = BUDDY_READ_LIMIT - total;
+	int piece = read_some(&inbuf[inlen], room);
+	if (piece > 0) {
+	    inlen += piece;
+	    total += piece;
+	    frame();
+	    continue;
+	}
+	if (piece < 0) {
+	    eof = true;
+	    res = -1;
+	}
+	break;
+    }
+    // The ring will not signal us again for what is left in it
+    if (shm && total >= BUDDY_READ_LIMIT) shm->wake_self();
+    return res < 0 ? res : total;
+}
 
-    return 0;
+// Move complete past the messages that are all here. Until the cert is
+// read, the input is length-prefixed records instead.
+void Buddy::frame()
+{
+    if (!has_cert) return;
+    if (complete < inpos) complete = inpos;
+    want = 0;
+    while (inlen - complete >= MSG_HEADER_LENGTH) {
+	size_t end = complete + frame_length(inbuf.data() + complete);
+	if (end > inlen) {
+	    want = end;
+	    return;
+	}
+	complete = end;
+    }
 }
 
-static void *launch_writer_thread(void *data)
+// Make room for a chunk, or for the rest of a large message. The buffer
+// grows to at most twice its size at a time, so a bogus length cannot
+// make us allocate much more than has actually arrived.
+void Buddy::make_room()
 {
-    Buddy *buddy = (Buddy *)data;
-    buddy->writer_thread();
-    pthread_exit(NULL);
+    size_t room = inlen + BUDDY_READ_CHUNK;
+    if (want > room) room = min(want, max(room, 2 * inbuf.size()));
+    if (inbuf.size() < room) inbuf.resize(room);
 }
 
-ssize_t write_fully(int fd, const char *buf, size_t len)
+// Where the length-prefixed record at pos ends, or 0 if it is not all here
+size_t Buddy::record_end(size_t pos) const
 {
-    ssize_t bytes_written = 0, res;
-    while(len) {
-    	 res = write(fd, buf, len);
-    	 if (res < 0) return res;
-    	 if (res == 0) return bytes_written;
-    	 bytes_written += res;
-    	 buf += res;
-    	 len -= res;
-    }
-    return bytes_written;
-}
-
-void Buddy::writer_thread(void) {
-	while (true) {
-
-		if (fd < 0) {
-			const map<BuddyID, ContactEntry> contactlist = buddyset.get_buddy_list();
-			map<BuddyID, ContactEntry>::const_iterator citer = contactlist.find(id);
-
-			if (citer != contactlist.end()) {
-				fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-				sockaddr_in sin;
-				sin.sin_family = AF_INET;
-				sin.sin_port = htons(citer->second.port);
-				sin.sin_addr.s_addr = htonl(citer->second.addr);
-				// cout << "Connecting for id " << id << endl;
-				int res = connect(fd, (sockaddr *)&sin, sizeof(sin));
-				if (res < 0) {
-					// this is original, but is this truely necessary?
-					// cout << "connection failed " << this -> get_id() << endl;
-					buddyset.notify_add_buddy_id(this);
-					close(fd);
-					return;
-				}   
-				send_cert(fd);
-				buddyset.notify_add_buddy_fd(fd, id);
-			} else {
-				return;    
-			}   
-		}
-		
-    		pthread_mutex_lock (&mutex);
+    if (inlen < pos + 4) return 0;
+    unsigned int len;
+    memmove(&len, inbuf.data() + pos, 4);
+    len = ntohl(len);
+    if (inlen - pos - 4 < len) return 0;
+    return pos + 4 + len;
+}
 
-		if (msgqueue.empty()) {
-			thread_is_running = false;
-			pthread_mutex_unlock (&mutex);
-			return;
-		} 
+bool Buddy::has_cert_records() const
+{
+    size_t end = record_end(inpos);
+    if (end == 0) return false;
+    if (get_param().use_certificates()) return record_end(end) != 0;
+    return true;
+}
 
-    		string msgstr = msgqueue.front();
-    		msgqueue.pop();
+// Take len bytes off the input buffer, or nothing if they are not all here
+int Buddy::read_record(unsigned char *buffer, size_t len)
+{
+    if (inlen - inpos < len) return 0;
+    memmove(buffer, inbuf.data() + inpos, len);
+    inpos += len;
+    return len;
+}
 
-		int msg_type = (int)msgstr[4];
+bool Buddy::has_message() const
+{
+    return complete > inpos;
+}
 
-		// int recv_id = (msgstr[0] << 24) | (((msgstr[1]) << 16) & 0x00ffffff) |
-		//	(((msgstr[2]) << 8) & 0x0000ffff) | (msgstr[3] & 0x000000ff);
+int Buddy::read_messagestr(string &msgstr)
+{
+    if (!has_message()) return -1;
 
-		if (msg_type == VSS_SEND || msg_type == VSS_ECHO || msg_type == VSS_READY || msg_type == LEADER_CHANGE) {
-			sentqueue.push(msgstr);
-		}
- 
-    		pthread_mutex_unlock (&mutex);
-    		size_t len = msgstr.size();
+    size_t len = frame_length(inbuf.data() + inpos);
+    msgstr.assign(inbuf, inpos, len);
+    inpos += len;
+
+    return 0;
+}
+
+// Open a non-blocking connection to the buddy's contact address. The
+// reactor reports it writable once it is up (or has failed).
+void Buddy::connect_buddy()
+{
+    const map<BuddyID, ContactEntry> &contactlist = buddyset.get_buddy_list();
+    map<BuddyID, ContactEntry>::const_iterator citer = contactlist.find(id);
+    if (citer == contactlist.end()) return;
+
+    int newfd;
+    if (buddyset.is_local(id)) {
+	// The link is up once the buddy answers our offer
+	newfd = shm_connect(citer->second.port);
+	if (newfd < 0) return;
+	shm = new ShmLink(true);
+	if (!shm->offer(newfd)) {
+	    delete shm;
+	    shm = NULL;
+	    close(newfd);
+	    return;
+	}
+    } else {
+	newfd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (newfd < 0) return;
+	fcntl(newfd, F_SETFL, O_NONBLOCK);
+	sockaddr_in sin;
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(citer->second.port);
+	sin.sin_addr.s_addr = htonl(citer->second.addr);
+	int res = connect(newfd, (sockaddr *)&sin, sizeof(sin));
+	if (res < 0 && errno != EINPROGRESS) {
+	    // The messages stay queued; the next write tries again
+	    close(newfd);
+	    return;
+	}
+    }
+
+    // This will eventually turn into actual TLS.  For now, we just
+    // exchange X.509 certs, but don't do any of the encryption.
+    const string &cert = buddyset.get_cert();
+    unsigned int len = htonl(cert.size());
+    handshake.assign((char *)&len, 4);
+    handshake.append(cert);
+    if (get_param().use_certificates()) {
+	const string &record = buddyset.get_bls_record();
+	len = htonl(record.size());
+	handshake.append((char *)&len, 4);
+	handshake.append(record);
+    }
+    outpos = 0;
+    connecting = true;
+    buddyset.add_buddy_fd(this, newfd);
+}
 
-    		// The following line may block!
-    		write_fully(fd, msgstr.data(), len);
+void Buddy::finish_connect()
+{
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0 || err) {
+	// cout << "connection failed " << this -> get_id() << endl;
+	buddyset.close_buddy(this);
+	return;
+    }
+    connecting = false;
+    flush();
+}
 
-	    	pthread_mutex_lock (&mutex);
-    		if (msgqueue.empty() == true) {
-    			thread_is_running = false;
-    			pthread_mutex_unlock (&mutex);
-    			return;
-    		}
+void Buddy::writable()
+{
+    if (connecting) finish_connect();
+    else flush();
+}
 
-    	pthread_mutex_unlock (&mutex);
+// Write as much of the queued output as the socket (or ring) takes,
+// gathering the queued messages into as few writev calls as it does
+void Buddy::flush()
+{
+    if (shm && !shm->is_up()) return;
+    bool wrote = false;
+    while (fd >= 0 && (handshake.size() || msgqueue.size())) {
+	struct iovec iov[BUDDY_IOV_MAX];
+	int n = 0;
+	if (handshake.size()) {
+	    iov[0].iov_base = (void *)(handshake.data() + outpos);
+	    iov[0].iov_len = handshake.size() - outpos;
+	    n = 1;
+	}
+	n += msgqueue.gather(iov + n, BUDDY_IOV_MAX - n);
+
+	ssize_t res;
+	if (shm) {
+	    // Room is signalled through the eventfd
+	    res = shm->writev(iov, n);
+	    if (res == 0) break;
+	    wrote = true;
+	} else res = writev(fd, iov, n);
+	if (res < 0) {
+	    if (errno == EINTR) continue;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+	    // The connection is gone; the rest waits for the next one
+	    buddyset.close_buddy(this);
+	    return;
+	}
+
+	size_t left = res;
+	if (handshake.size()) {
+	    size_t rest = handshake.size() - outpos;
+	    if (left < rest) {
+		outpos += left;
+		continue;
+	    }
+	    left -= rest;
+	    handshake.clear();
+	    outpos = 0;
+	}
+	while (left > 0) {
+	    size_t rest = msgqueue.front_left();
+	    if (left < rest) {
+		msgqueue.skip(left);
+		break;
+	    }
+	    left -= rest;
+
+	    int msg_type = msgqueue.front().type();
+	    if (msg_type == VSS_SEND || msg_type == VSS_ECHO || msg_type == VSS_READY || msg_type == LEADER_CHANGE) {
+		sentqueue.push(msgqueue.front());
+	    }
+	    msgqueue.pop();
+	}
     }
+    if (wrote) shm->wake_reader();
+    update_watch();
+}
+
+void Buddy::update_watch()
+{
+    if (fd < 0 || shm || wants_output() == watching_out) return;
+    watching_out = wants_output();
+    buddyset.watch_buddy(this, watching_out);
+}
+
+void Buddy::start_output()
+{
+    if (fd < 0) connect_buddy();
+    else if (!connecting) flush();
 }
 
 void Buddy::help(fstream &msgLog) {
 	timeval now;
-	pthread_mutex_lock (&mutex);
 	while (!sentqueue.empty()) {
-		string msgstr = sentqueue.front();
+		OutMsg msg = sentqueue.front();
 		sentqueue.pop();
 
-		msgqueue.push(msgstr);
+		msgqueue.push(msg, NetworkMessage::priority(msg.type()));
+
+		const char *msgstr = msg.header();
 
 		int msg_type = (int)msgstr[4];
 		int recv_id = (msgstr[0] << 24) | (((msgstr[1]) << 16) & 0x00ffffff) |
@@ -360,76 +590,57 @@ void Buddy::help(fstream &msgLog) {
 				msgLog << "* " << recv_id << " for " << "* SENT from * to " << id << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << "from help "  << endl;
 		}
 	}
-	pthread_mutex_unlock (&mutex);
-
-	if (!thread_is_running && msgqueue.size() != 0) {
-		// Launch the writer thread
-		thread_is_running = true;
-		pthread_attr_t attr;
-    		pthread_attr_init(&attr);
-    		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    		pthread_t threadid;
-    		pthread_create(&threadid, &attr, launch_writer_thread, this);
-   	 }
 
+	if (msgqueue.size() != 0) start_output();
 }
 
 void Buddy::write_messagestr(const string &msgstr)
 {
-    pthread_mutex_lock (&mutex);
-
-    msgqueue.push(msgstr);
-    pthread_mutex_unlock (&mutex);
+    write_message(OutMsg(msgstr));
+}
 
-    if (!thread_is_running) {
-    	// Launch the writer thread
-    	thread_is_running = true;
-    	pthread_attr_t attr;
-    	pthread_attr_init(&attr);
-    	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    	pthread_t threadid;
+void Buddy::write_message(const OutMsg &msg)
+{
+    SimBus *bus = buddyset.get_bus();
+    if (bus) {
+	// There is no connection; the bus delivers it
+	bus->send(buddyset.get_my_id(), id, msg);
+	return;
+    }
+    msgqueue.push(msg, NetworkMessage::priority(msg.type()));
+    start_output();
+}
 
-    	if (msgqueue.empty() == true) {
-           	cout << "HERE2 the msgqueue is EMPTY!!" << endl;
-		// This should never happen
-        }
+int Buddy::sig_size() const
+{
+    if (get_param().use_certificates()) return buddyset.sig_size();
+    return cert_sig_size();
+}
 
-    	pthread_create(&threadid, &attr, launch_writer_thread, this);
-    }
+int Buddy::cert_sig_size() const
+{
+    return ed25519_pubkey.size() ? ED25519_SIG_SIZE : 40;
 }
 
 int Buddy::verify(const unsigned char *data, size_t len,
 	const unsigned char *sig) const
 {
-    // First hash the data
-    unsigned char hashbuf[20];
-    gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, data, len);
-
-    // Make an mpi out of the hash
-    gcry_mpi_t hashm;
-    gcry_mpi_scan(&hashm, GCRYMPI_FMT_USG, hashbuf, 20, NULL);
-
-    // Make an sexp out of the mpi
-    gcry_sexp_t hashs;
-    gcry_sexp_build(&hashs, NULL, "(%m)", hashm);
-    gcry_mpi_release(hashm);
-// Make mpis out of the signature
-    gcry_mpi_t r, s;
-    gcry_mpi_scan(&r, GCRYMPI_FMT_USG, sig, 20, NULL);
-    gcry_mpi_scan(&s, GCRYMPI_FMT_USG, sig+20, 20, NULL);
-
-    // Make an sexp for the signature
-    gcry_sexp_t sigs;
-    gcry_sexp_build(&sigs, NULL, "(sig-val (dsa (r %m)(s %m)))", r, s);
-    gcry_mpi_release(r);
-    gcry_mpi_release(s);
-
-    // Verify the signature
-    gcry_error_t vrf = gcry_pk_verify(sigs, hashs, buddy_dsa_pubkey);
-    gcry_sexp_release(sigs);
-    gcry_sexp_release(hashs);
-
-    return vrf ? -1 : 0;
+    if (!get_param().use_certificates()) return cert_verify(data, len, sig);
+    if (!has_bls_pubkey) return -1;
+    const SystemParam &sys = get_param();
+    const Pairing &e = sys.get_Pairing();
+    G1 msgHash;
+    hash_signed(msgHash, data, len, e);
+    G1 signature(e, sig, sig_size(), true);
+    return e(sys.get_U(), signature) == e(bls_pubkey, msgHash) ? 0 : -1;
+}
+
+// Verify with the key of the buddy's certificate
+int Buddy::cert_verify(const unsigned char *data, size_t len,
+	const unsigned char *sig) const
+{
+    if (ed25519_pubkey.size()) return ed25519_verify(ed25519_pubkey, data, len, sig);
+    return dsa_verify(buddy_dsa_pubkey, data, len, sig);
 }
 
 Buddy *Buddy::find_other_buddy(BuddyID id) const
@@ -27,11 +27,22 @@
 #include <gnutls/x509.h>
 #include <fstream>
 #include "systemparam.h"
+#include "sendring.h"
+#include "shmlink.h"
 
 using namespace std;
 
 typedef NodeID BuddyID;
 
+//Input is read in chunks of BUDDY_READ_CHUNK, and at most BUDDY_READ_LIMIT
+//bytes per event, so that a busy buddy does not hold up the others. A
+//buffer grown past BUDDY_READ_LIMIT for a large message is let go once
+//it is drained.
+#define BUDDY_READ_CHUNK 65536
+#define BUDDY_READ_LIMIT (1 << 20)
+//Most iovecs handed to one writev
+#define BUDDY_IOV_MAX 256
+
 //class for buddy 
 class Buddy{
  public:
@@ -42,38 +53,101 @@ class Buddy{
     const SystemParam &get_param() const;
     void close_fd();
     int get_fd() const { return fd; }
+    //The eventfd of a shared memory link that is up, or -1
+    int get_notify_fd() const {
+	return shm && shm->is_up() ? shm->get_eventfd() : -1;
+    }
+    //An accepted connection over which a co-located node sets up a link
+    void accept_local() { shm = new ShmLink(false); }
+    //The other side of the shared memory link signalled us
+    void notified();
     int got_cert() const { return has_cert; }
     BuddyID get_id() const { return id; }
     Buddy *find_other_buddy(BuddyID id) const;
-    int read_messagestr(string &msgstr) const;
+    //Read what the socket has into the input buffer; <0 once the peer
+    //has closed the connection
+    int fill();
+    bool peer_closed() const { return eof; }
+    //Set if a whole message is buffered; found as the input comes in
+    bool has_message() const;
+    //The type of the next message, if has_message()
+    int next_type() const { return (unsigned char)inbuf[inpos + 4]; }
+    bool has_cert_records() const;
+    int read_messagestr(string &msgstr);
     void write_messagestr(const string &msgstr);
-    void writer_thread(void);
-    int sig_size() const { return 40; }
+    void write_message(const OutMsg &msg);
+    //Called by the reactor once the socket takes more output
+    void writable();
+    bool wants_output() const {
+	return connecting || handshake.size() || msgqueue.size();
+    }
+    int sig_size() const;
     int verify(const unsigned char *data, size_t len,
 	    const unsigned char *sig) const;
+    bool got_bls_pubkey() const { return has_bls_pubkey; }
+    const G1& get_bls_pubkey() const { return bls_pubkey; }
+    //Take the BLS key from the record the buddy would send after its cert
+    //(for buddies we have no connection to, in a simulation)
+    void set_bls_record(const unsigned char *record, size_t len);
+    //Empty unless the buddy's cert has an Ed25519 key
+    const string& get_ed25519_pubkey() const { return ed25519_pubkey; }
+    gcry_sexp_t get_dsa_pubkey() const { return buddy_dsa_pubkey; }
     void read_cert() { get_cert(); }
-    const class BuddySet &get_buddyset(){return buddyset;}
+    const class BuddySet &get_buddyset() const {return buddyset;}
     
-    void set_fd (int fd) {this->fd = fd;}
+    void set_fd (int fd) {this->fd = fd; watching_out = false;}
+    //Ask the reactor for output events while there is output pending
+    void update_watch();
      void set_cert(string cert);
-     void send_cert(int usefd = -1) const;
      void help(fstream &msgLog);
-     queue<string> msgqueue;
-     queue<string> sentqueue;
-     pthread_mutex_t mutex;
+     SendQueue msgqueue;
+     SendRing sentqueue;
      
  private:
      BuddySet &buddyset;
      int fd;
-     bool thread_is_running;
      BuddyID id;
      int is_server;
      int has_cert;
      gcry_sexp_t buddy_dsa_pubkey;
+     string ed25519_pubkey;
+     bool has_bls_pubkey;
+     G1 bls_pubkey;
+     //Bytes read but not yet taken are inbuf[inpos, inlen); the rest of
+     //inbuf is room to read into. Whole messages end at or before
+     //complete, and want is where the partial one after them ends.
+     string inbuf;
+     size_t inpos;
+     size_t inlen;
+     size_t complete;
+     size_t want;
+     //Set for a co-located buddy; the fd is then the unix socket it was set up over
+     ShmLink *shm;
+     bool eof;
+     //Our cert records, sent ahead of msgqueue on a new connection
+     string handshake;
+     //How much of the handshake is written
+     size_t outpos;
+     bool connecting;
+     bool watching_out;
 
-     int read_record(unsigned char *buffer, size_t len) const;
+     int read_record(unsigned char *buffer, size_t len);
+     size_t record_end(size_t pos) const;
+     int read_input();
+     int read_some(char *buf, size_t len);
+     int local_event();
+     void frame();
+     void make_room();
+     int cert_sig_size() const;
+     int cert_verify(const unsigned char *data, size_t len,
+	    const unsigned char *sig) const;
+     void set_pubkey(gnutls_x509_crt_t buddy_cert);
+     void read_bls_pubkey();
      void get_cert();
-     void destroy_mutex();
+     void connect_buddy();
+     void finish_connect();
+     void start_output();
+     void flush();
 
   //To include public and private key
 };
@@ -19,18 +19,24 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <fcntl.h>
 #include <gnutls/x509.h>
 #include "buddyset.h"
+#include "io.h"
+#include "ed25519.h"
+#include "dsa.h"
 
 using namespace std;
 
 BuddySet::BuddySet(const SystemParam &sysparams, const char *certfilename,
-	const char *keyfilename): sysparams(sysparams)
+	const char *keyfilename): sysparams(sysparams), bus(NULL), last_fd_found(-1)
 {
-	my_dsa_privkey = NULL;
+	my_dsa_signer = NULL;
+	my_ed25519_privkey = NULL;
     if (keyfilename) {
 	gnutls_x509_privkey_t my_privkey;
 	gnutls_x509_privkey_init(&my_privkey);
@@ -45,34 +51,66 @@ BuddySet::BuddySet(const SystemParam &sysparams, const char *certfilename,
 	keydatum.data = (unsigned char *)keystring.data();
 	keydatum.size = keystring.size();
 	gnutls_x509_privkey_import(my_privkey, &keydatum, GNUTLS_X509_FMT_PEM);
+	string certSecret;
+	if (gnutls_x509_privkey_get_pk_algorithm(my_privkey) == GNUTLS_PK_EDDSA_ED25519) {
+	    // x is the public key and k the 32 byte secret
+	    gnutls_ecc_curve_t curve;
+	    gnutls_datum_t xd, yd, kd;
+	    gnutls_x509_privkey_export_ecc_raw(my_privkey, &curve, &xd, &yd, &kd);
+	    gnutls_x509_privkey_deinit(my_privkey);
+	    certSecret.assign((char *)kd.data, kd.size);
+	    my_ed25519_privkey = ed25519_privkey(certSecret, string((char *)xd.data, xd.size));
+	    gnutls_free(xd.data);
+	    gnutls_free(yd.data);
+	    gnutls_free(kd.data);
+	} else {
+		// Extract the params from the privkey
+		gnutls_datum_t pd, qd, gd, yd, xd;
+		gnutls_x509_privkey_export_dsa_raw(my_privkey, &pd, &qd, &gd, &yd,
+			&xd);
+		gnutls_x509_privkey_deinit(my_privkey);
+
+		// Construct libgcrypt MPIs from the pieces
+		gcry_mpi_t p, q, g, y, x;
+		gcry_mpi_scan(&p, GCRYMPI_FMT_USG, pd.data, pd.size, NULL);
+		gcry_mpi_scan(&q, GCRYMPI_FMT_USG, qd.data, qd.size, NULL);
+		gcry_mpi_scan(&g, GCRYMPI_FMT_USG, gd.data, gd.size, NULL);
+		gcry_mpi_scan(&y, GCRYMPI_FMT_USG, yd.data, yd.size, NULL);
+		gcry_mpi_scan(&x, GCRYMPI_FMT_USG, xd.data, xd.size, NULL);
+		certSecret.assign((char *)xd.data, xd.size);
+		gnutls_free(pd.data);
+		gnutls_free(qd.data);
+		gnutls_free(gd.data);
+		gnutls_free(yd.data);
+		gnutls_free(xd.data);
+
+		// The signer starts precomputing nonces at its first sign(), on a
+		// thread of its own; set_bus() has it make them inline instead
+		my_dsa_signer = new DSASigner(p, q, g, x);
+		gcry_mpi_release(y);
+	}
 
-	// Extract the params from the privkey
-	gnutls_datum_t pd, qd, gd, yd, xd;
-	gnutls_x509_privkey_export_dsa_raw(my_privkey, &pd, &qd, &gd, &yd,
-		&xd);
-	gnutls_x509_privkey_deinit(my_privkey);
-
-	// Construct libgcrypt MPIs from the pieces
-	gcry_mpi_t p, q, g, y, x;
-	gcry_mpi_scan(&p, GCRYMPI_FMT_USG, pd.data, pd.size, NULL);
-	gcry_mpi_scan(&q, GCRYMPI_FMT_USG, qd.data, qd.size, NULL);
-	gcry_mpi_scan(&g, GCRYMPI_FMT_USG, gd.data, gd.size, NULL);
-	gcry_mpi_scan(&y, GCRYMPI_FMT_USG, yd.data, yd.size, NULL);
-	gcry_mpi_scan(&x, GCRYMPI_FMT_USG, xd.data, xd.size, NULL);
-	gnutls_free(pd.data);
-	gnutls_free(qd.data);
-	gnutls_free(gd.data);
-	gnutls_free(yd.data);
-	gnutls_free(xd.data);
-
-	// Build the sexp holding the private DSA key
-	gcry_sexp_build(&my_dsa_privkey, NULL,
-		"(private-key(dsa(p%m)(q%m)(g%m)(y%m)(x%m)))", p, q, g, y, x);
-	gcry_mpi_release(p);
-	gcry_mpi_release(q);
-	gcry_mpi_release(g);
-	gcry_mpi_release(y);
-	gcry_mpi_release(x);
+	if (sysparams.use_certificates()) {
+	    // Derive the BLS key from the certificate one, so that it survives restarts
+	    const Pairing &e = sysparams.get_Pairing();
+	    unsigned char seed[32];
+	    string seedInput("DKG node BLS key");
+	    seedInput.append(certSecret);
+	    gcry_md_hash_buffer(GCRY_MD_SHA256, seed, seedInput.data(), seedInput.size());
+	    my_bls_privkey = Zr(e, (void *)seed, 32);
+	    string pubkey = (sysparams.get_U()^my_bls_privkey).toString(true);
+
+	    // Proof of possession, against rogue keys in aggregated certificates
+	    G1 popHash;
+	    hash_signed(popHash, (const unsigned char *)pubkey.data(), pubkey.size(),
+		    e, "DKG node BLS key possession");
+	    my_bls_record = pubkey + (popHash^my_bls_privkey).toString(true);
+
+	    // Bind the key to our certificate
+	    unsigned char certsig[cert_sig_size()];
+	    cert_sign((const unsigned char *)pubkey.data(), pubkey.size(), certsig);
+	    my_bls_record.append((char *)certsig, cert_sig_size());
+	}
     }    
     if (certfilename) {
 	// Read the file
@@ -105,16 +143,19 @@ BuddySet::BuddySet(const SystemParam &sysparams, const char *certfilename,
 	}
 	gnutls_x509_crt_deinit(cert);
     }
-
-    // Create the pipe used to notify the main thread of a newly
-    // connected Buddy
-    pipe(notifyfds);
-    pipe(notifyids);
 }
 
 BuddySet::~BuddySet()
 {
-    gcry_sexp_release(my_dsa_privkey);
+    delete my_dsa_signer;
+    gcry_sexp_release(my_ed25519_privkey);
+}
+
+void BuddySet::set_bus(SimBus *bus)
+{
+    this->bus = bus;
+    // Nonces made on a thread of their own would not be charged to this node
+    if (my_dsa_signer) my_dsa_signer->set_background(bus == NULL);
 }
 
 void BuddySet::init_contact_list(const char *filename)
@@ -129,12 +170,10 @@ void BuddySet::init_contact_list(const char *filename)
 		getline(file, nextline);
 		if (file.eof()) break;
 		// Parse each line of the file
-		// Format: id <space> i.p.ad.dr <space> port <space>[L]
-		int id, a1, a2, a3, a4, port;
-		char leader_char;
+		// Format: id <space> i.p.ad.dr <space> port <space> certfile [<space>L] [<space>S]
+		int id, a1, a2, a3, a4, port, used = 0;
 		char certfilename[200];
-		int res = sscanf(nextline.data(), "%d %d.%d.%d.%d %d %s %c",&id, &a1, &a2, &a3, &a4, &port, certfilename, &leader_char);
-		if ((res == 8)&& (leader_char == 'L')) {isleader = true; leader = id;}
+		int res = sscanf(nextline.data(), "%d %d.%d.%d.%d %d %199s%n",&id, &a1, &a2, &a3, &a4, &port, certfilename, &used);
 		if (res < 7) {
 	    	cerr << "Bad scanned line: " << nextline << "\n";
 	    	continue;
@@ -143,6 +182,13 @@ void BuddySet::init_contact_list(const char *filename)
 		ContactEntry ce;
 		ce.addr = (a1 << 24) + (a2 << 16) + (a3 << 8) + a4;
 		ce.port = port;
+		ce.local = false;
+		istringstream flags(nextline.substr(used));
+		string flag;
+		while (flags >> flag) {
+			if (flag[0] == 'L') {isleader = true; leader = id;}
+			else if (flag == "S") ce.local = true;
+		}
 		contactlist[id] = ce;
 		
 		//Add Buddy and Certificate
@@ -186,79 +232,86 @@ BuddyID BuddySet::get_previous_leader(){
     else
     	return contactlist.rbegin()->first;
 }
-int BuddySet::set_fds(fd_set *fdsp)
+void BuddySet::handle_event(int fd, bool readable, bool writable)
 {
-    // Set the new buddy notification pipe for sure
-    FD_SET(notifyfds[0], fdsp);
-    FD_SET(notifyids[0], fdsp);
-    int maxfd = notifyfds[0];
-    if (notifyids[0] > maxfd) {
-	maxfd = notifyids[0];
-    }
-    for (map<int, Buddy*>::iterator fditer = fdmap.begin();
-	    fditer != fdmap.end(); fditer++) {
-//    	cerr << "set dsp: " << fditer->first << endl;
-	FD_SET(fditer->first, fdsp);
-	if (fditer->first > maxfd) maxfd = fditer->first;
-    }
-    return maxfd;
-}
+    map<int, Buddy*>::iterator fditer = fdmap.find(fd);
+    if (fditer == fdmap.end()) return;
+    Buddy *buddy = fditer->second;
 
-Buddy *BuddySet::find_set_fd(fd_set *fdsp)
-{
-    // First, see if we have data on the new buddy notification pipe
-    if (FD_ISSET(notifyfds[0], fdsp)) {
-	int newfd;
-	BuddyID newid;
-	char buf[sizeof(newfd)+sizeof(newid)];
-	read(notifyfds[0], buf, sizeof(newfd)+sizeof(newid));
-	memmove(&newfd, buf, sizeof(newfd));
-	memmove(&newid, buf+sizeof(newfd), sizeof(newid));
-	add_buddy_fd(newfd, newid);
+    if (fd == buddy->get_notify_fd()) {
+	// The shared memory ring has input, or room for our output
+	buddy->notified();
+    } else {
+	if (writable) buddy->writable();
+	if (!readable || buddy->get_fd() != fd) return;
+	buddy->fill();
     }
-
-    // then, see if we have failed connections
-    if (FD_ISSET(notifyids[0], fdsp)) {
-	Buddy* newBuddy;
-	char buf[sizeof(newBuddy)];
-	read(notifyids[0], buf, sizeof(newBuddy));
-	memmove(&newBuddy, buf, sizeof(newBuddy)); if (find_buddy(newBuddy->get_id()) == NULL) {
-		// just now there has not been an incoming connection
-		// idmap[newBuddy->get_id()] = newBuddy;
-		add_buddy_id (newBuddy);
+    if (buddy->got_cert() == 0) {
+	if (!buddy->has_cert_records()) {
+	    // Closed socket; get rid of this buddy
+	    if (buddy->peer_closed()) close_buddy(buddy);
+	    return;
+	}
+	buddy->read_cert();
+	if (buddy->got_cert() == 0) {
+	    close_buddy(buddy);
+	    return;
 	}
+	add_buddy_id(buddy);
     }
-	
 
-    map<int, Buddy*>::iterator fditer, startat;
-    startat = fdmap.find(last_fd_found);
-    if (startat != fdmap.end()) {
-	++startat;
+    // Messages already read still go out before a close
+    if (buddy->has_message()) {
+	buffered.insert(buddy->get_fd());
+    } else if (buddy->peer_closed()) {
+	close_buddy(buddy);
     }
-    if (startat == fdmap.end()) {
-	startat = fdmap.begin();
-    }
-    for (fditer = startat; fditer != fdmap.end(); fditer++) {
-	if (FD_ISSET(fditer->first, fdsp)) { 
-	    last_fd_found = fditer->first;
-	    return fditer->second;
+}
+
+// The buddy whose next message is in the most urgent class, round robin
+// among those in the same class
+Buddy *BuddySet::next_buffered()
+{
+    Buddy *best = NULL;
+    int bestClass = PRIORITY_CLASSES;
+    vector<int> drained;
+    set<int>::iterator found = buffered.upper_bound(last_fd_found);
+    for (size_t i = 0; i < buffered.size(); i++, ++found) {
+	if (found == buffered.end()) found = buffered.begin();
+	map<int, Buddy*>::iterator fditer = fdmap.find(*found);
+	if (fditer == fdmap.end() || !fditer->second->has_message()) {
+	    drained.push_back(*found);
+	    continue;
+	}
+	int msgClass = NetworkMessage::priority(fditer->second->next_type());
+	if (msgClass < bestClass) {
+	    best = fditer->second;
+	    bestClass = msgClass;
+	    if (msgClass == PRIORITY_AGREEMENT) break;
 	}
     }
-    for (fditer = fdmap.begin(); fditer != startat; fditer++) {
-	if (FD_ISSET(fditer->first, fdsp)) { 
-	    last_fd_found = fditer->first;
-	    return fditer->second;
+
+    // Drained; close them now if the peer is gone
+    for (size_t i = 0; i < drained.size(); i++) {
+	buffered.erase(drained[i]);
+	map<int, Buddy*>::iterator fditer = fdmap.find(drained[i]);
+	if (fditer != fdmap.end() && fditer->second->peer_closed()) {
+	    close_buddy(fditer->second);
 	}
     }
-    return NULL;
+    if (best) last_fd_found = best->get_fd();
+    return best;
 }
 
-Buddy *BuddySet::add_buddy_fd(int fd)
+Buddy *BuddySet::add_buddy_fd(int fd, bool local)
 {
 
+    fcntl(fd, F_SETFL, O_NONBLOCK);
     Buddy *newbuddy = new Buddy(*this, fd);
+    if (local) newbuddy->accept_local();
     
     fdmap[fd] = newbuddy;
+    reactor.add(fd);
     BuddyID id = newbuddy->get_id();
   // cerr << "Special Adding buddy" << id << " ;" << "fd " << fd << endl;
     //cerr<<"Adding new Buddy "<<id<<" at "<<fd<<endl;
@@ -281,12 +334,11 @@ void BuddySet::add_buddy_id(Buddy *buddy)
 	// cout << "for node " <<  buddy->get_id() << endl;
 	if (oriBuddy != NULL) {
 		//cout << "HERE!!" << endl;
-		pthread_mutex_lock (&(oriBuddy->mutex));
 		buddy->msgqueue = oriBuddy->msgqueue;
+		buddy->msgqueue.restart();
 		buddy->sentqueue = oriBuddy->sentqueue;
 		// cout << "oriBuddy-> sentqueuesize = " << (oriBuddy->sentqueue).size() << endl;
 		// cout << "oriBuddy-> msgqueuesize = " << (oriBuddy->msgqueue).size() << endl;
-		pthread_mutex_unlock (&(oriBuddy->mutex));
 	}
 	idmap[buddy->get_id()] = buddy;
 }
@@ -299,58 +351,65 @@ Buddy *BuddySet::find_buddy_id(BuddyID id) const
     return found->second;
 }
 
-void BuddySet::notify_add_buddy_id(Buddy *buddy)
+// Attach a new outgoing connection to a buddy that has none
+void BuddySet::add_buddy_fd(Buddy *buddy, int fd)
 {
-    // Tell the main thread to add (id, *buddy) to the id map
-	char buf[sizeof(buddy)];
-	memmove(buf, &buddy, sizeof(buddy));
-	write(notifyids[1], buf, sizeof(buddy));
+    buddy->set_fd(fd);
+    fdmap[fd] = buddy;
+    reactor.add(fd);
+    buddy->update_watch();
 }
 
-void BuddySet::notify_add_buddy_fd(int fd, BuddyID id)
+void BuddySet::add_notify_fd(Buddy *buddy)
 {
-    // Tell the main thread to add (fd,id) to the buddy map
-    char buf[sizeof(fd)+sizeof(id)];
-    memmove(buf, &fd, sizeof(fd));
-    memmove(buf+sizeof(fd), &id, sizeof(id));
-    write(notifyfds[1], buf, sizeof(fd)+sizeof(id));
-    // cout << "Add buddy fd notified" << endl;
-    // cout << fd << " " << id << endl;
+    int fd = buddy->get_notify_fd();
+    fdmap[fd] = buddy;
+    reactor.add(fd);
 }
 
-Buddy *BuddySet::add_buddy_fd(int fd, BuddyID id)
+bool BuddySet::is_local(BuddyID id) const
 {
-    //Buddy *buddy = new Buddy(*this, fd, id);
-    
-     // This will eventually turn into actual TLS.  For now, we just
-    // exchange X.509 certs, but don't do any of the encryption.
-	//cerr << "Adding buddy" << id << " ;" << "fd " << fd << endl;
-    Buddy *buddy = find_buddy_id(id);
-
-    if (buddy == NULL) {
-    	buddy = new Buddy(*this, fd, id);
-    	idmap[buddy->get_id()] = buddy;
-    } else {
-	  int old_fd = buddy->get_fd();
-	  fdmap.erase(old_fd);	  	  
-	}
-	buddy->set_fd(fd);
-	fdmap[fd] = buddy; 
-    return buddy;
+    map<BuddyID, ContactEntry>::const_iterator mine = contactlist.find(my_id);
+    map<BuddyID, ContactEntry>::const_iterator theirs = contactlist.find(id);
+    return mine != contactlist.end() && mine->second.local &&
+	theirs != contactlist.end() && theirs->second.local;
+}
+
+void BuddySet::watch_buddy(Buddy *buddy, bool out)
+{
+    reactor.watch(buddy->get_fd(), out);
 }
 
 void BuddySet::close_buddy(Buddy *buddy)
 {
     int fd = buddy->get_fd();
-    fdmap.erase(fd);
+    int notifyfd = buddy->get_notify_fd();
+    if (notifyfd >= 0) {
+	fdmap.erase(notifyfd);
+	reactor.remove(notifyfd);
+    }
+    if (fd >= 0) {
+	fdmap.erase(fd);
+	buffered.erase(fd);
+	reactor.remove(fd);
+    }
     buddy->close_fd();
 }
 
 void BuddySet::del_buddy(Buddy *buddy)
 {
     int fd = buddy->get_fd();
+    int notifyfd = buddy->get_notify_fd();
     BuddyID id = buddy->get_id();
-    if (fd >= 0) fdmap.erase(fd);
+    if (notifyfd >= 0) {
+	fdmap.erase(notifyfd);
+	reactor.remove(notifyfd);
+    }
+    if (fd >= 0) {
+	fdmap.erase(fd);
+	buffered.erase(fd);
+	reactor.remove(fd);
+    }
     idmap.erase(id);
     delete buddy;
     if (fd >= 0) close(fd);
@@ -372,49 +431,74 @@ void BuddySet::send_message(BuddyID id, const NetworkMessage &message)
     buddy->write_messagestr(message.get_netMsgStr());
 }
 
+void BuddySet::broadcast(const vector<BuddyID> &ids, const NetworkMessage &message,
+	const vector<string> *tails, vector<int> *msgIDs)
+{
+    if (ids.empty()) return;
+    const string &msgstr = message.get_netMsgStr();
+    size_t headlen = NetworkMessage::msgIDLength + NetworkMessage::headerLength;
+    size_t taillen = tails ? (*tails)[0].size() : 0;
+    MsgRef body(msgstr.substr(headlen, msgstr.size() - headlen - taillen));
+
+    for (size_t i = 0; i < ids.size(); i++) {
+	int ID = i ? Message::next_ID() : message.get_ID();
+	if (msgIDs) msgIDs->push_back(ID);
+	Buddy *buddy = find_buddy(ids[i], 1);
+	if (!buddy) continue;
+
+	OutMsg out;
+	size_t len = body.size() + (tails ? (*tails)[i].size() : 0);
+	// 4 byte ID, type and 4 byte length
+	unsigned char header[9];
+	header[0] = (ID >> 24) & 0xff;
+	header[1] = (ID >> 16) & 0xff;
+	header[2] = (ID >> 8) & 0xff;
+	header[3] = ID & 0xff;
+	header[4] = msgstr[NetworkMessage::msgIDLength];
+	header[5] = (len >> 24) & 0xff;
+	header[6] = (len >> 16) & 0xff;
+	header[7] = (len >> 8) & 0xff;
+	header[8] = len & 0xff;
+	out.add(MsgRef(string((char *)header, headlen)));
+	out.add(body);
+	if (tails) out.add(MsgRef((*tails)[i]));
+	buddy->write_message(out);
+    }
+}
+
+size_t BuddySet::sig_size() const
+{
+    if (sysparams.use_certificates())
+	return sysparams.get_Pairing().getElementSize(Type_G1, true);
+    return cert_sig_size();
+}
+
+size_t BuddySet::cert_sig_size() const
+{
+    return my_ed25519_privkey ? ED25519_SIG_SIZE : 40;
+}
+
 void BuddySet::sign(const unsigned char *data, size_t len,
 	unsigned char *sig) const
 {
-    // First hash the data
-    unsigned char hashbuf[20];
-    gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, data, len);
-
-    // Make an mpi out of the hash
-    gcry_mpi_t hashm;
-    gcry_mpi_scan(&hashm, GCRYMPI_FMT_USG, hashbuf, 20, NULL);
-
-    // Make an sexp out of the mpi
-    gcry_sexp_t hashs;
-    gcry_sexp_build(&hashs, NULL, "(%m)", hashm);
-    gcry_mpi_release(hashm);
-
-    // Sign the sexp
-    gcry_sexp_t sigs;
-    gcry_pk_sign(&sigs, hashs, my_dsa_privkey);
-    gcry_sexp_release(hashs);
-
-    // Find the r and s pieces inside
-    gcry_sexp_t dsas, rs, ss;
-    gcry_mpi_t r, s;
-    dsas = gcry_sexp_find_token(sigs, "dsa", 0);
-    gcry_sexp_release(sigs);
-    rs = gcry_sexp_find_token(dsas, "r", 0);
-    ss = gcry_sexp_find_token(dsas, "s", 0);
-    gcry_sexp_release(dsas);
-    r = gcry_sexp_nth_mpi(rs, 1, GCRYMPI_FMT_USG);
-    gcry_sexp_release(rs);
-    s = gcry_sexp_nth_mpi(ss, 1, GCRYMPI_FMT_USG);
-    gcry_sexp_release(ss);
-
-    // Write them to the appropriate place
-    size_t nr, ns;
-    gcry_mpi_print(GCRYMPI_FMT_USG, NULL, 0, &nr, r);
-    gcry_mpi_print(GCRYMPI_FMT_USG, NULL, 0, &ns, s);
-    memset(sig, 0, 40);
-    gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)sig+(20-nr),
-	    nr, NULL, r);
-    gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)sig+20+(20-ns),
-	    ns, NULL, s);
-    gcry_mpi_release(r);
-    gcry_mpi_release(s);
+    if (!sysparams.use_certificates()) {
+	cert_sign(data, len, sig);
+	return;
+    }
+    G1 msgHash;
+    hash_signed(msgHash, data, len, sysparams.get_Pairing());
+    string blssig = (msgHash^my_bls_privkey).toString(true);
+    memcpy(sig, blssig.data(), blssig.size());
+}
+
+// Sign with the key of our certificate
+void BuddySet::cert_sign(const unsigned char *data, size_t len,
+	unsigned char *sig) const
+{
+    if (my_ed25519_privkey) {
+	ed25519_sign(my_ed25519_privkey, data, len, sig);
+	return;
+    }
+
+    my_dsa_signer->sign(data, len, sig);
 }
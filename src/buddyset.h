@@ -21,20 +21,26 @@
 #define __BUDDYSET_H__
 
 #include <map>
+#include <set>
 #include <netinet/in.h>
 #include <gnutls/gnutls.h>
 #include <gcrypt.h>
 #include <queue>
 #include <string>
+#include <vector>
 #include "systemparam.h"
 #include "buddy.h"
+#include "commitment.h"
+#include "sigpool.h"
 #include "networkmessage.h"
+#include "reactor.h"
 
 using namespace std;
 
 struct ContactEntry {
     in_addr_t addr;
     in_port_t port;
+    bool local;//Marked " S": on our host, reached through shared memory
 };
 
 class BuddySet {
@@ -44,21 +50,45 @@ class BuddySet {
 
 	const SystemParam &get_param() const { return sysparams; }
 	void init_contact_list(const char *filename);
-	int set_fds(fd_set *fdsp);
-	Buddy *find_set_fd(fd_set *fdsp);
-	Buddy *add_buddy_fd(int fd);
-	Buddy *add_buddy_fd(int fd, BuddyID id);
-	void notify_add_buddy_fd(int fd, BuddyID id);
-	void notify_add_buddy_id(Buddy *buddy);
+	Reactor &get_reactor() { return reactor; }
+	//With a bus, messages go over it instead of connections (simbus.h)
+	void set_bus(class SimBus *bus);
+	class SimBus *get_bus() const { return bus; }
+	//Handle the reactor's event on a buddy's fd
+	void handle_event(int fd, bool readable, bool writable);
+	//Round robin over the buddies with a whole message buffered
+	bool has_buffered() const { return !buffered.empty(); }
+	Buddy *next_buffered();
+	//local: a unix socket over which a co-located node sets up a link
+	Buddy *add_buddy_fd(int fd, bool local = false);
+	void add_buddy_fd(Buddy *buddy, int fd);
+	//Watch the eventfd of a buddy's shared memory link, once it is up
+	void add_notify_fd(Buddy *buddy);
+	//Whether we and id are both marked as local in the contact list
+	bool is_local(BuddyID id) const;
+	void watch_buddy(Buddy *buddy, bool out);
 	void add_buddy_id(Buddy *buddy);
 	Buddy *find_buddy_id(BuddyID id) const;
 	void close_buddy(Buddy *buddy);
 	void del_buddy(Buddy *buddy);
 	void send_message(BuddyID id, const class NetworkMessage &message);
+	//Send message to each buddy in ids, serialized once and shared. Each
+	//copy gets its own message ID, returned in msgIDs. With tails, the
+	//last tails[0].size() bytes of the message's body are replaced by
+	//tails[i] for ids[i] (the alpha of a VSS_ECHO, say).
+	void broadcast(const vector<BuddyID> &ids, const class NetworkMessage &message,
+		const vector<string> *tails = NULL, vector<int> *msgIDs = NULL);
 	const string &get_cert() const { return my_cert; }
-	size_t sig_size() const { return 40; }
+	//Per node, so that nodes sharing a process (a simulation) do not share
+	//what they have seen
+	SigCache &get_sig_cache() const { return goodSigs; }
+	CommitmentStore &get_commitments() const { return commitments; }
+	size_t sig_size() const;
 	void sign(const unsigned char *data, size_t len,
 		unsigned char *sig) const;
+	//Our BLS public key, its proof of possession and a DSA signature on it;
+	//sent after the cert when certificates are used
+	const string &get_bls_record() const { return my_bls_record; }
 	const map<BuddyID, ContactEntry>& get_buddy_list ()const {return contactlist;}
 	BuddyID get_my_id() const {return my_id;}
 	BuddyID get_leader() const {return leader;}
@@ -88,13 +118,22 @@ class BuddySet {
 	map<BuddyID, int> first_msg_type;
 	BuddyID leader;
 	string my_cert;
-	gcry_sexp_t my_dsa_privkey;
+	class DSASigner *my_dsa_signer;
+	gcry_sexp_t my_ed25519_privkey;//Used instead of the DSA key for Ed25519 certs
+	Zr my_bls_privkey;
+	string my_bls_record;
 	NodeID my_id;
+	Reactor reactor;
+	class SimBus *bus;
+	set<int> buffered;
 	int last_fd_found;
-	int notifyfds[2];
-	int notifyids[2];
+	mutable SigCache goodSigs;
+	mutable CommitmentStore commitments;
 
 	Buddy *find_buddy(BuddyID id, int contact = 0);
+	size_t cert_sig_size() const;
+	void cert_sign(const unsigned char *data, size_t len,
+		unsigned char *sig) const;
 };
 
 #endif
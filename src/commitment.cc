@@ -17,15 +17,17 @@
 
 
 
+#include <queue>
+#include <gcrypt.h>
 #include "commitment.h"
 #include "io.h"
 #include "lagrange.h"
 
 Commitment::Commitment(const SystemParam& sys, const vector <NodeID>& activeNodes, CommitmentType type)
-:hashedVector(sys,activeNodes), matrix(sys),type(type){}
+:hashedVector(sys,activeNodes), matrix(sys),type(type),rowVerified(false){}
 	  
 Commitment::Commitment(const SystemParam& sys, const vector <NodeID>& activeNodes,const BiPolynomial& fxy,CommitmentType type)
-:hashedVector(sys,activeNodes, fxy),matrix(sys, fxy),type(type){}
+:hashedVector(sys,activeNodes, fxy),matrix(sys, fxy),type(type),rowVerified(false){}
 /*	
 {	if(type == Feldman_Matrix) 
 		matrix= CommitmentMatrix(sys, fxy);
@@ -36,7 +38,7 @@ Commitment::Commitment(const SystemParam& sys, const vector <NodeID>& activeNode
 
 // Copy constructor
 Commitment::Commitment(const Commitment &rhs)
-:hashedVector(rhs.hashedVector),matrix(rhs.matrix),type(rhs.get_Type()){}
+:hashedVector(rhs.hashedVector),matrix(rhs.matrix),type(rhs.get_Type()),rowVerified(false){}
 	//I might copy mechanism for echo and ready here
 
 
@@ -46,10 +48,17 @@ Commitment& Commitment:: operator=(const Commitment &rhs){
 	type = rhs.get_Type();
 	hashedVector = rhs.get_Vector();
 	matrix = rhs.get_Matrix();
+	//As with copying, the points collected so far belong to the old commitment
+	A_Echo.clear(); A_Ready.clear();
+	pendingEcho.clear(); pendingReady.clear();
+	rejectedEcho.clear(); rejectedReady.clear();
+	echoPaths.clear(); readyPaths.clear();
+	row = Polynomial();
+	rowVerified = false;
 	return *this;
 }
 	    
-Commitment::Commitment(const SystemParam& sys, const unsigned char *&buf, size_t& len){
+Commitment::Commitment(const SystemParam& sys, const unsigned char *&buf, size_t& len):rowVerified(false){
 	unsigned char commType; read_byte(buf,len,commType); type = (CommitmentType)commType;
 	if (type == Feldman_Matrix) {
 		matrix = CommitmentMatrix(sys, buf,len);
@@ -69,6 +78,62 @@ string Commitment::toString(bool includeSubshares) const{
 	return str;
 }
 	
+string Commitment::toDigestString(CommitmentStore &store) const{
+	if (type != Feldman_Matrix) return toString();
+	string str;
+	write_byte(str, COMMITMENT_BY_DIGEST);
+	str.append(store.remember(*this));
+	return str;
+}
+
+static string digest_of(const string &str){
+	unsigned char hash[COMMITMENT_DIGEST_SIZE];
+	gcry_md_hash_buffer(GCRY_MD_SHA256, hash, str.data(), str.size());
+	return string((char *)hash, COMMITMENT_DIGEST_SIZE);
+}
+
+string Commitment::digest() const{
+	return digest_of(toString());
+}
+
+string CommitmentStore::remember(const Commitment &C){
+	string str = C.toString();
+	string d = digest_of(str);
+	if (known.count(d)) return d;
+	if (order.size() >= COMMITMENT_STORE_ENTRIES) {
+		known.erase(order.front());
+		order.pop();
+	}
+	// Copying leaves out the points collected on C
+	entry &e = known[d];
+	e.C = C;
+	e.str.swap(str);
+	order.push(d);
+	return d;
+}
+
+bool CommitmentStore::recall(const string &digest, Commitment &C) const{
+	map<string, entry>::const_iterator found = known.find(digest);
+	if (found == known.end()) return false;
+	C = found->second.C;
+	return true;
+}
+
+bool CommitmentStore::recall_string(const string &digest, string &str) const{
+	map<string, entry>::const_iterator found = known.find(digest);
+	if (found == known.end()) return false;
+	str = found->second.str;
+	return true;
+}
+
+bool Commitment::read_digest(const unsigned char *&buf, size_t &len, string &digest){
+	if (len < 1 + COMMITMENT_DIGEST_SIZE || buf[0] != COMMITMENT_BY_DIGEST) return false;
+	digest.assign((const char *)buf + 1, COMMITMENT_DIGEST_SIZE);
+	buf += 1 + COMMITMENT_DIGEST_SIZE;
+	len -= 1 + COMMITMENT_DIGEST_SIZE;
+	return true;
+}
+	
 bool Commitment::operator==(const Commitment &rhs) const{
 	if (type != rhs.get_Type()) return false;
 	if (type == Feldman_Matrix) 
@@ -137,6 +202,102 @@ interpolate(const SystemParam& sys, bool EchoOrReady, const vector<NodeID>& acti
 	}	
 	return 	subshares;
 }	
+bool Commitment::addUnverifiedMsg(const SystemParam& sys, bool EchoOrReady, NodeID sender,
+								  const Zr& alpha, const Commitment& received){
+	map <NodeID, Zr> &A_C = (EchoOrReady? A_Ready : A_Echo);
+	set <NodeID> &pending = (EchoOrReady? pendingReady : pendingEcho);
+	set <NodeID> &rejected = (EchoOrReady? rejectedReady : rejectedEcho);
+	
+	if (A_C.find(sender) != A_C.end() || rejected.find(sender) != rejected.end())
+		return false;
+	if (rowVerified){
+		if (!(row(Zr(sys.get_Pairing(),(long)sender)) == alpha)){
+			rejected.insert(sender);
+			return false;
+		}
+		A_C.insert(make_pair(sender, alpha));
+		return true;
+	}
+	A_C.insert(make_pair(sender, alpha));
+	pending.insert(sender);
+	if (type == Feldman_Vector)
+		(EchoOrReady? readyPaths : echoPaths)[sender] = received.get_Vector().getAuthPaths();
+	return true;
+}
+
+bool Commitment::verifyShares(const SystemParam& sys, NodeID selfID, bool EchoOrReady,
+							  const vector<NodeID>& activeList, vector<Zr>& subshares){
+	const map <NodeID, Zr> &A_C = (EchoOrReady? A_Ready : A_Echo);
+	NodeIDSize t = sys.get_t();
+	
+	//Any t+1 points fix the row; all others have to lie on it
+	vector <Zr> indices, evals;
+	map<NodeID, Zr>::const_iterator Zr_it;
+	for(Zr_it = A_C.begin(); Zr_it != A_C.end() && indices.size() <= t; ++Zr_it){
+		indices.push_back(Zr(sys.get_Pairing(),(long)Zr_it->first));
+		evals.push_back(Zr_it->second);
+	}
+	Polynomial poly(indices, evals);
+	bool valid = (indices.size() == (size_t)t + 1);
+	for(; valid && Zr_it != A_C.end(); ++Zr_it)
+		valid = (poly(Zr(sys.get_Pairing(),(long)Zr_it->first)) == Zr_it->second);
+	
+	if (valid){
+		subshares = interpolate(sys, EchoOrReady, activeList);
+		if (type == Feldman_Matrix)
+			valid = matrix.verifyPoly(sys, selfID, poly);
+		else {
+			hashedVector.setSubshares(sys, subshares);
+			valid = hashedVector.checkPoly(selfID);
+		}
+	}
+	if (!valid){
+		verifyPending(sys, selfID, EchoOrReady);
+		return false;
+	}
+	
+	row = poly;
+	rowVerified = true;
+	pendingEcho.clear(); pendingReady.clear();
+	echoPaths.clear(); readyPaths.clear();
+	//Points of the other kind collected so far can now be checked for free
+	map <NodeID, Zr> &A_other = (EchoOrReady? A_Echo : A_Ready);
+	set <NodeID> &rejected = (EchoOrReady? rejectedEcho : rejectedReady);
+	for(map<NodeID, Zr>::iterator it = A_other.begin(); it != A_other.end();){
+		if (!(row(Zr(sys.get_Pairing(),(long)it->first)) == it->second)){
+			rejected.insert(it->first);
+			A_other.erase(it++);
+		} else ++it;
+	}
+	return true;
+}
+
+bool Commitment::verifyPending(const SystemParam& sys, NodeID selfID, bool EchoOrReady){
+	map <NodeID, Zr> &A_C = (EchoOrReady? A_Ready : A_Echo);
+	set <NodeID> &pending = (EchoOrReady? pendingReady : pendingEcho);
+	set <NodeID> &rejected = (EchoOrReady? rejectedReady : rejectedEcho);
+	map <NodeID, map <NodeID, vector <string> > > &paths = (EchoOrReady? readyPaths : echoPaths);
+	
+	bool allValid = true;
+	for(set <NodeID>::const_iterator it = pending.begin(); it != pending.end(); ++it){
+		map <NodeID, Zr>::iterator point = A_C.find(*it);
+		if (point == A_C.end()) continue;
+		bool valid;
+		if (type == Feldman_Matrix)
+			valid = matrix.verifyPoint(sys, *it, selfID, point->second);
+		else
+			valid = hashedVector.verifyPoint(sys, *it, selfID, point->second, paths[*it]);
+		if (!valid){
+			A_C.erase(point);
+			rejected.insert(*it);
+			allValid = false;
+		}
+	}
+	pending.clear();
+	paths.clear();
+	return allValid;
+}
+
 void Commitment::dump(FILE *f, unsigned int indent) const{
 	if (type == Feldman_Matrix){ 
 		fprintf(f, "%*s  Feldman Matrix\n", indent,"");
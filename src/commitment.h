@@ -21,6 +21,8 @@
 #define __COMMITMENT_H__
 
 #include <map>
+#include <queue>
+#include <set>
 #include <vector>
 #include "commitmentvector.h"
 #include "commitmentmatrix.h"
@@ -28,6 +30,12 @@
 
 typedef enum {Feldman_Matrix, Feldman_Vector} CommitmentType;
 
+//Type byte of a matrix commitment sent as the SHA-256 digest of its toString()
+#define COMMITMENT_BY_DIGEST 2
+#define COMMITMENT_DIGEST_SIZE 32
+//How many commitments are kept for resolving digests
+#define COMMITMENT_STORE_ENTRIES 1024
+
 class Commitment{
 
 private:
@@ -37,9 +45,17 @@ private:
 		
 	map <NodeID, Zr> A_Echo;//Shares received from various members during Echo messages
 	map <NodeID, Zr> A_Ready;//Shares received from various members during Ready messages
+	
+	//Verify-at-threshold: points in A_Echo/A_Ready not yet checked against the commitment
+	set <NodeID> pendingEcho, pendingReady;
+	set <NodeID> rejectedEcho, rejectedReady;
+	//Feldman_Vector only: authentication paths that came with each pending point
+	map <NodeID, map <NodeID, vector <string> > > echoPaths, readyPaths;
+	Polynomial row;//Our verified row, once known
+	bool rowVerified;
 		
 public:
-	Commitment(){}
+	Commitment():rowVerified(false){}
 	  
 	Commitment(const SystemParam& sys, const vector <NodeID> & activeNodes, CommitmentType type);
 	//Initialize with identity Entries
@@ -56,6 +72,13 @@ public:
    ~Commitment(){}
 	
 	string toString(bool includeSubshares = true) const;
+	//The digest form of a matrix commitment (toString() for a vector one).
+	//The commitment is remembered in store, to answer requests for it.
+	string toDigestString(class CommitmentStore &store) const;
+	string digest() const;
+
+	//Take a digest form commitment off buf, if that is what is there
+	static bool read_digest(const unsigned char *&buf, size_t &len, string &digest);
 	
 	//With Echo and Ready messages, we add points 
 	bool addEchoMsg(NodeID sender, const Zr& alpha){
@@ -75,6 +98,21 @@ public:
 		A_Ready.insert(make_pair(sender, alpha));
 		return true;}
 		  
+	//Add a point without checking it; received is the commitment it came with.
+	//Once our row is verified, points are checked against it right away.
+	bool addUnverifiedMsg(const SystemParam& sys, bool EchoOrReady, NodeID sender,
+						  const Zr& alpha, const Commitment& received);
+	
+	//At the threshold: interpolate our row from the collected points and check it
+	//against the commitment once. Returns the interpolated subshares (as interpolate)
+	//and true on success. On failure, checks the points one by one, drops the bad
+	//ones and returns false.
+	bool verifyShares(const SystemParam& sys, NodeID selfID, bool EchoOrReady,
+					  const vector<NodeID>& activeList, vector<Zr>& subshares);
+	
+	//Check pending points one by one. Returns false if any were dropped.
+	bool verifyPending(const SystemParam& sys, NodeID selfID, bool EchoOrReady);
+		  
 	unsigned short getEchoMsgCnt() const {return (unsigned short)A_Echo.size();}
 	unsigned short getReadyMsgCnt() const {return (unsigned short)A_Ready.size();}
 	  
@@ -85,6 +123,7 @@ public:
 	const CommitmentVector get_Vector() const {return hashedVector;}
 	
 	void setSubshares(const SystemParam& sys, const vector <Zr>& values) {hashedVector.setSubshares(sys, values);}
+	void setAuthPaths(NodeID verifierID) {if (type == Feldman_Vector) hashedVector.setAuthPaths(verifierID);}
 		
 	Commitment& operator*=(const Commitment &rhs);
 	//Here each entry is multiplied with corresponding entry in rhs.
@@ -104,4 +143,22 @@ public:
 	void dump(FILE *f, unsigned int indent = 0) const; 
   
 };
+
+//The commitments one node knows by digest
+class CommitmentStore{
+public:
+	//Returns the digest
+	string remember(const Commitment &C);
+	bool recall(const string &digest, Commitment &C) const;
+	//The commitment's toString(), kept from when it was remembered
+	bool recall_string(const string &digest, string &str) const;
+
+private:
+	struct entry {
+		Commitment C;
+		string str;
+	};
+	map <string, entry> known;
+	queue <string> order;
+};
 #endif
@@ -17,6 +17,7 @@
 
 
 
+#include <gcrypt.h>
 #include "commitmentmatrix.h"
 #include "io.h"
 
@@ -79,11 +80,7 @@ CommitmentMatrix(const SystemParam& sys, const unsigned char *&buf,
   for(unsigned short i = 0; i<rowcnt; ++i){
 	vector<G1> row;
 	unsigned short colcnt; read_us(buf, len, colcnt);
-	for(unsigned short j = 0; j<colcnt; ++j){
-	  G1 entry;
-	  read_G1(buf, len, entry, sys.get_Pairing());
-	  row.push_back(entry);
-    }
+	read_G1s(buf, len, row, colcnt, sys);
 	entries.push_back(row);	     
   }
 }
@@ -131,13 +128,18 @@ CommitmentMatrix& CommitmentMatrix::operator*=(const CommitmentMatrix &rhs){
 }
 
 bool CommitmentMatrix::verifyPoly(const SystemParam& sys, NodeID verifierID, 
-								  const Polynomial& poly) const {
+								  const Polynomial& poly, bool randomized) const {
   Zr i(poly.getCoeff(0),(long int)verifierID);
   G1 U = sys.get_U();
+  //With randomized set, the t+1 coefficient checks U^a_l == E_l are folded into 
+  //U^(sum r_l*a_l) == prod E_l^r_l for random 63 bit r_l; a wrong coefficient 
+  //passes with probability 2^-63. The product is one multiexp over the short
+  //weights, and U^(sum r_l*a_l) the one full-size exponentiation.
+  Zr lhsExp(poly.getCoeff(0),(long int)0);
+  vector<G1> rhss;
+  vector<Zr> weights;
   for(int l = 0; l <= poly.degree(); ++l){
-	G1 lhs(U,true);
 	G1 rhs(U,true);
-	lhs = U^poly.getCoeff(l);
 	//using Horner's rule
 	size_t jj = entries.size();
     while(jj > 0){
@@ -145,8 +147,16 @@ bool CommitmentMatrix::verifyPoly(const SystemParam& sys, NodeID verifierID,
 	  rhs^=i;
 	  rhs*=entries[jj][l];	  
 	}
-	if (!(lhs == rhs)) return false;
+	if (randomized){
+	  unsigned long long r;
+	  gcry_create_nonce(&r, sizeof(r));
+	  Zr weight(poly.getCoeff(0),(long int)((r >> 1) | 1));
+	  lhsExp += poly.getCoeff(l)*weight;
+	  rhss.push_back(rhs);
+	  weights.push_back(weight);
+	} else if (!((U^poly.getCoeff(l)) == rhs)) return false;
   }
+  if (randomized) return (U^lhsExp) == G1::multiexp(rhss, weights);
   return true;
 }
 
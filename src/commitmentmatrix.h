@@ -77,7 +77,8 @@ public:
     	return CommitmentMatrix(*this) *= rhs;
 	}
 		 
-	bool verifyPoly(const SystemParam& sys, NodeID verifierID, const Polynomial& poly) const;
+	//randomized: one combined check instead of one per coefficient
+	bool verifyPoly(const SystemParam& sys, NodeID verifierID, const Polynomial& poly, bool randomized = true) const;
 
 	bool verifyPoint(const SystemParam& sys, NodeID senderID, 
 				   NodeID verifierID, const Zr& point) const;
@@ -19,9 +19,72 @@
 
 #include "commitmentvector.h"
 #include "io.h"
+#include "sha256mb.h"
 
 #define HashSize 32
 
+//Merkle tree helpers. Leaves and inner nodes are domain separated.
+//A node without a sibling is carried up to the next level unchanged.
+static string merkle_leaf(const G1& entry){
+	string str;
+	write_byte(str,0);
+	write_G1(str,entry);
+	unsigned char hashbuf[HashSize];
+	gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, str.data(), str.length());
+	return string((const char*)hashbuf,HashSize);
+}
+
+static string merkle_node(const string& left, const string& right){
+	string str;
+	write_byte(str,1);
+	str.append(left);str.append(right);
+	unsigned char hashbuf[HashSize];
+	gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, str.data(), str.length());
+	return string((const char*)hashbuf,HashSize);
+}
+
+//Hash count equal length messages stored back to back in buf
+static vector <string> hash_all(const string& buf, size_t count){
+	vector <string> digests;
+	if (!count) return digests;
+	vector <unsigned char> out(count*HashSize);
+	sha256_multi((const unsigned char*)buf.data(), buf.length()/count, count, &out[0]);
+	for (size_t i = 0; i < count; ++i)
+		digests.push_back(string((const char*)&out[i*HashSize],HashSize));
+	return digests;
+}
+
+static vector <vector <string> > merkle_tree(const vector <G1>& entries){
+	vector <vector <string> > tree(1);
+	//Serialize all leaves into one buffer and hash them in lock-step
+	string leaves;
+	size_t leaflen = 0;
+	bool sameLength = true;
+	for(vector <G1>:: const_iterator it = entries.begin(); it != entries.end(); ++it){
+		size_t start = leaves.length();
+		write_byte(leaves,0);
+		write_G1(leaves,*it);
+		if (it == entries.begin()) leaflen = leaves.length();
+		else if (leaves.length() - start != leaflen) sameLength = false;
+	}
+	if (sameLength) tree[0] = hash_all(leaves, entries.size());
+	else for(vector <G1>:: const_iterator it = entries.begin(); it != entries.end(); ++it)
+		tree[0].push_back(merkle_leaf(*it));//Identity entries serialize shorter
+	
+	while(tree.back().size() > 1){
+		const vector <string> &level = tree.back();
+		string pairs;
+		for(size_t i = 0; i + 1 < level.size(); i += 2){
+			write_byte(pairs,1);
+			pairs.append(level[i]);pairs.append(level[i+1]);
+		}
+		vector <string> next = hash_all(pairs, level.size()/2);
+		if (level.size() % 2) next.push_back(level.back());
+		tree.push_back(next);
+	}
+	return tree;
+}
+
 CommitmentVector::CommitmentVector(const SystemParam& sys, const vector <NodeID>& activeNodes){
 	
 	indices.push_back(0);
@@ -39,34 +102,27 @@ CommitmentVector::CommitmentVector(const SystemParam& sys, const vector <NodeID>
   //Generate shares
     G1 U = sys.get_U();
     
-    string strShares;
     vector <NodeID>:: const_iterator it2d; 	
  	for(it2d = indices.begin(); it2d != indices.end();++it2d){    
        	G1 entry  = U^(fxy.apply(Zr(sys.get_Pairing(),(long)*it2d))(Zr(sys.get_Pairing(),(long)0)));       	
        	shares.push_back(entry); 
-  		write_G1(strShares,entry);//For hash
  	}
- 	unsigned char hashbuf[HashSize]; 
- 	gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, strShares.data(), strShares.length());
-	//hashbuf[HashSize]= 0;
-	hashes.push_back(string((const char*)hashbuf,HashSize));
+	hashes.push_back(merkle_tree(shares).back()[0]);
  	
  	it2d = indices.begin();++it2d;   		 
 	for(;it2d != indices.end();++it2d){
-		string strSubshares;  		  
+		vector <G1> row;
   		for (vector <NodeID>:: const_iterator it1d = indices.begin();it1d != indices.end();++it1d){  			
    			G1 entry  = U^(fxy.apply(Zr(sys.get_Pairing(),(long)*it2d))(Zr(sys.get_Pairing(),(long)*it1d)));
-   			write_G1(strSubshares,entry);//For hash
+   			row.push_back(entry);
    		}		
-   		unsigned char hashbuf[HashSize];   		
-  		gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, strSubshares.data(), strSubshares.length());
-  		//hashbuf[HashSize]= 0;
-		hashes.push_back(string((const char*)hashbuf,HashSize));		
+		hashes.push_back(merkle_tree(row).back()[0]);		
 	}
 }
 
 // Copy constructor
-CommitmentVector::CommitmentVector(const CommitmentVector &vec):indices(vec.getIndices()){	
+CommitmentVector::CommitmentVector(const CommitmentVector &vec)
+:indices(vec.getIndices()),rowTree(vec.getRowTree()),authPaths(vec.getAuthPaths()){	
 	vector <G1>::iterator it;
 	vector <string>::iterator itstr;
 	vector <G1> shV = vec.getShares();		
@@ -84,6 +140,8 @@ CommitmentVector& CommitmentVector::operator=(const CommitmentVector &vec){
 	
 	indices.clear();shares.clear();hashes.clear();subshares.clear();
 	indices = vec.getIndices();
+	rowTree = vec.getRowTree();
+	authPaths = vec.getAuthPaths();
 	vector <G1> shV = vec.getShares();		
 	vector <G1> subshV = vec.getSubshares();
 	vector <string> strV = vec.getHashes();
@@ -99,7 +157,7 @@ CommitmentVector::
 CommitmentVector(const SystemParam& sys, const unsigned char *&buf, size_t& len){
 	
 	G1 U = sys.get_U();
-	indices.clear(); shares.clear();hashes.clear();subshares.clear();	
+	indices.clear(); shares.clear();hashes.clear();subshares.clear();authPaths.clear();	
 	//indices.push_back(0); indices.insert(indices.end(),activeNodes.begin(),activeNodes.end());
 
 	//read indices
@@ -111,10 +169,7 @@ CommitmentVector(const SystemParam& sys, const unsigned char *&buf, size_t& len)
     
 	//read shares
 	NodeIDSize sharecnt; read_us(buf, len, sharecnt);
-	for(NodeIDSize j = 0; j<sharecnt; ++j){
-		G1 entry; read_G1(buf, len, entry, sys.get_Pairing());
-		shares.push_back(entry);
-    }
+	read_G1s(buf, len, shares, sharecnt, sys);
 
     //read hashes
    	NodeIDSize hashcnt; read_us(buf, len, hashcnt);
@@ -123,12 +178,17 @@ CommitmentVector(const SystemParam& sys, const unsigned char *&buf, size_t& len)
 		hashes.push_back(hash);
     }
 
-	//read subshares
-	NodeIDSize subsharecnt; read_us(buf, len, subsharecnt);
-	if (!(subsharecnt)) return;
-	for(NodeIDSize j = 0; j<subsharecnt; ++j){
-		G1 entry;read_G1(buf, len, entry, sys.get_Pairing());
-		subshares.push_back(entry);
+	//read authentication paths
+	NodeIDSize pathcnt; read_us(buf, len, pathcnt);
+	for(NodeIDSize j = 0; j<pathcnt; ++j){
+		NodeID leaf; read_us(buf, len, leaf);
+		NodeIDSize depth; read_us(buf, len, depth);
+		vector <string> path;
+		for(NodeIDSize k = 0; k<depth; ++k){
+			string hash; read_str(buf, len, hash, HashSize);
+			path.push_back(hash);
+		}
+		authPaths.insert(make_pair(leaf,path));
     }
 }
 
@@ -151,10 +211,15 @@ string CommitmentVector:: toString(bool includeSubshares) const{
 	for(iterHash = hashes.begin(); iterHash != hashes.end(); ++iterHash)
 		write_str(returnStr,*iterHash, HashSize);
 
+	//Subshares never leave the node; the receiver only needs authentication paths
 	if(includeSubshares){
-	write_us(returnStr,(unsigned short)subshares.size());
-	for(iterG1 = subshares.begin(); iterG1 != subshares.end(); ++iterG1)
-		write_G1(returnStr,*iterG1);
+	write_us(returnStr,(unsigned short)authPaths.size());
+	for(map <NodeID, vector <string> >::const_iterator itPath = authPaths.begin(); itPath != authPaths.end(); ++itPath){
+		write_us(returnStr,itPath->first);
+		write_us(returnStr,(unsigned short)itPath->second.size());
+		for(iterHash = itPath->second.begin(); iterHash != itPath->second.end(); ++iterHash)
+			write_str(returnStr,*iterHash, HashSize);
+	}
 	} else write_us(returnStr,(unsigned short)0);
 	return returnStr;
 }
@@ -180,6 +245,7 @@ void CommitmentVector::setSubshares(const vector <G1>& subshares){
 		this->subshares.push_back(entry);
 		//entry.dump(stderr);
 	}
+	buildRowTree();
 }
 
 void CommitmentVector::setSubshares(const SystemParam& sys,const vector <Zr>& values){
@@ -190,6 +256,25 @@ void CommitmentVector::setSubshares(const SystemParam& sys,const vector <Zr>& va
 		//entry.dump(stderr);
        	subshares.push_back(entry);
  	}
+ 	buildRowTree();
+}
+
+void CommitmentVector::buildRowTree(){
+	rowTree = merkle_tree(subshares);
+	authPaths.clear();
+}
+
+void CommitmentVector::setAuthPaths(NodeID verifierID){
+	authPaths.clear();
+	if (rowTree.empty()) return;
+	NodeID leaves[2] = {0, verifierID};
+	for (int l = 0; l < 2; ++l){
+		vector <string> path;
+		size_t pos = leaves[l];
+		for (size_t level = 0; level + 1 < rowTree.size(); ++level, pos >>= 1)
+			if ((pos^1) < rowTree[level].size()) path.push_back(rowTree[level][pos^1]);
+		authPaths[leaves[l]] = path;
+	}
 }
 
 CommitmentVector& CommitmentVector::operator*=(const CommitmentVector &rhs){
@@ -207,20 +292,30 @@ bool CommitmentVector::checkPoly(NodeID verifierID) const{
 	if (!(subshares[0] == shares[verifierID])){cerr<<"Error with share comparison\n"; 
 		return false;}
 	
-	string strSubshares;
-	for(vector <G1> :: const_iterator it = subshares.begin(); it != subshares.end(); ++it)
-		write_G1(strSubshares,*it);//For hash		
-	unsigned char hashbuf[HashSize];
-	
-	gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, strSubshares.data(), strSubshares.length());
-	//hashbuf[HashSize]= 0;
-	if (string((const char*)hashbuf, HashSize) != hashes[verifierID])	{
-		cerr<< "Created hash: "<<hashbuf<< " Received hash: "<<hashes[verifierID];
+	if (rowTree.empty() || rowTree.back()[0] != hashes[verifierID])	{
+		cerr<< "Merkle root does not match for row "<<verifierID<<endl;
 		return false;
 	}	
 	return true;		
 }
 
+//Walk the authentication path of leaf in the given row up to the root
+bool CommitmentVector::checkPath(NodeID row, NodeID leaf, const G1& entry,
+								 const map <NodeID, vector <string> >& paths) const{
+	map <NodeID, vector <string> >::const_iterator itPath = paths.find(leaf);
+	if (itPath == paths.end() || row >= hashes.size() || leaf >= indices.size()) return false;
+	
+	string node = merkle_leaf(entry);
+	vector <string>::const_iterator sibling = itPath->second.begin();
+	for (size_t pos = leaf, width = indices.size(); width > 1; pos >>= 1, width = (width + 1) >> 1){
+		if ((pos^1) >= width) continue;//carried up without a sibling
+		if (sibling == itPath->second.end()) return false;
+		node = (pos & 1)? merkle_node(*sibling, node) : merkle_node(node, *sibling);
+		++sibling;
+	}
+	return (sibling == itPath->second.end()) && (node == hashes[row]);
+}
+
 
 bool CommitmentVector::verifyPoly(const SystemParam& sys, NodeID verifierID, 
 								  const Polynomial& poly) {
@@ -231,22 +326,26 @@ bool CommitmentVector::verifyPoly(const SystemParam& sys, NodeID verifierID,
        	G1 entry  = U^(poly(Zr(sys.get_Pairing(),(long)*it2d)));
        	subshares.push_back(entry);
  	}
+ 	buildRowTree();
  	if (checkPoly(verifierID)) return true;
- 	else {subshares.clear();return false;}
+ 	else {subshares.clear();rowTree.clear();return false;}
 }
 
 bool CommitmentVector::verifyPoint(const SystemParam& sys, NodeID senderID,
 								   NodeID verifierID, const Zr& point) const{
+	return verifyPoint(sys, senderID, verifierID, point, authPaths);
+}
+
+bool CommitmentVector::verifyPoint(const SystemParam& sys, NodeID senderID, NodeID verifierID,
+								   const Zr& point, const map <NodeID, vector <string> >& paths) const{
 	G1 U = sys.get_U();
-	if (!(subshares[verifierID] == (U^point))) {
+	if (senderID >= shares.size()) return false;
+	if (!checkPath(senderID, verifierID, U^point, paths)) {
 		cerr<<"Error with share verification for "<<verifierID<<"\n";
-		for (vector <G1>::const_iterator it = subshares.begin(); it != subshares.end(); ++it) it->dump(stderr);
-		subshares[verifierID].dump(stderr);
-		(U^point).dump(stderr);
 		return false;
 	}
-	 	
-	if (!checkPoly(senderID)) {cerr<<"Error with CheckPoly\n";return false;}
+	//Row senderID should also start with the share committed for senderID
+	if (!checkPath(senderID, 0, shares[senderID], paths)) {cerr<<"Error with CheckPoly\n";return false;}
 	return true;
 }
 
@@ -306,6 +405,7 @@ int main(int argc, char **argv)
 	else
 	  cout<<"Error in Polynomial Verification"<<endl;
 
+	cm.setAuthPaths(1);
 	if (cm.verifyPoint(param,3,1,val))
 	//	if (cm.verifyPoint(param, 5,0,val)): Doesn't work for zero
 	  cout<<"Point Verified"<<endl;
@@ -36,7 +36,9 @@ class CommitmentVector{
   vector <NodeID> indices;
   vector <G1> shares;//Vector Entries [0] row
   vector <G1> subshares;//Vector Entries [i] the row
-  vector <string> hashes;//hash of vectors
+  vector <string> hashes;//Merkle roots of vectors
+  vector <vector <string> > rowTree;//Merkle tree over subshares, leaves first. Not serialized
+  map <NodeID, vector <string> > authPaths;//Authentication paths for subshares leaves
   
 public:
   CommitmentVector(){} 
@@ -66,9 +68,12 @@ public:
 	const vector <G1> getShares() const {return shares;}
 	const vector <string> getHashes() const {return hashes;}
 	const vector <G1> getSubshares() const {return subshares;}
+	const vector <vector <string> > getRowTree() const {return rowTree;}
+	const map <NodeID, vector <string> > getAuthPaths() const {return authPaths;}
 	
 	void setSubshares(const vector <G1>& subshares);
 	void setSubshares(const SystemParam& sys,const vector <Zr>& values);
+	void setAuthPaths(NodeID verifierID);//Paths for leaf 0 and leaf verifierID of the subshares row
 	bool operator==(const CommitmentVector &vec) const;
 	
 	CommitmentVector& operator*=(const CommitmentVector &rhs);
@@ -84,10 +89,18 @@ public:
 
 	bool verifyPoint(const SystemParam& sys, NodeID senderID, 
 				   NodeID verifierID,const Zr& point) const;
+	//Same, with authentication paths kept from an earlier message
+	bool verifyPoint(const SystemParam& sys, NodeID senderID, NodeID verifierID,
+				   const Zr& point, const map <NodeID, vector <string> >& paths) const;
+
+	//Check the subshares row set for verifierID against the commitment
+	bool checkPoly(NodeID verifierID) const;
 
   	void dump(FILE *f, unsigned int indent = 0) const; 
   	
   	private:
-  	bool checkPoly(NodeID verifierID) const;
+  	bool checkPath(NodeID row, NodeID leaf, const G1& entry,
+  				   const map <NodeID, vector <string> >& paths) const;
+  	void buildRowTree();
 };
 #endif
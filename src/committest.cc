@@ -0,0 +1,95 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+//Checks that a commitment which is assigned over starts verifying afresh:
+//no points, no verified row and no rejections carry over from the old one.
+//Usage: committest, with pairing.param and system.param in the current
+//directory.
+
+#include <iostream>
+#include "commitment.h"
+
+static long failures = 0;
+
+static void check(bool ok, const char *what)
+{
+	if (!ok) {
+		cout << "FAILED: " << what << endl;
+		++failures;
+	}
+}
+
+//The echo point from sender for selfID under fxy
+static Zr point(const SystemParam &sys, const BiPolynomial &fxy, NodeID sender, NodeID selfID)
+{
+	const Pairing &e = sys.get_Pairing();
+	return fxy(Zr(e, (long)sender))(Zr(e, (long)selfID));
+}
+
+//Add echo points from senders 1..count, all under fxy
+static bool addPoints(const SystemParam &sys, Commitment &C, const BiPolynomial &fxy,
+					  NodeID count, NodeID selfID)
+{
+	bool ok = true;
+	for (NodeID m = 1; m <= count; ++m)
+		ok = C.addUnverifiedMsg(sys, false, m, point(sys, fxy, m, selfID), C) && ok;
+	return ok;
+}
+
+int main()
+{
+	SystemParam sys("pairing.param", "system.param");
+	const Pairing &e = sys.get_Pairing();
+	NodeIDSize t = sys.get_t();
+	NodeID selfID = 1, n = 2*t + 2;
+	vector <NodeID> nodes;
+	for (NodeID i = 1; i <= n; ++i) nodes.push_back(i);
+	vector <Zr> subshares;
+
+	for (int type = Feldman_Matrix; type <= Feldman_Vector; ++type) {
+		BiPolynomial f1(sys, t, Zr(e, true)), f2(sys, t, Zr(e, true));
+		Commitment C1(sys, nodes, f1, (CommitmentType)type);
+		Commitment C2(sys, nodes, f2, (CommitmentType)type);
+
+		Commitment C(C1);
+		check(addPoints(sys, C, f1, t + 1, selfID), "points for the first commitment");
+		check(C.verifyShares(sys, selfID, false, nodes, subshares),
+			  "row of the first commitment");
+		//Once the row is known, a point off it is turned away
+		check(!C.addUnverifiedMsg(sys, false, t + 2, point(sys, f2, t + 2, selfID), C),
+			  "point off the verified row");
+
+		C = C2;
+		check(C.getEchoMsgCnt() == 0 && C.getReadyMsgCnt() == 0,
+			  "no points left after assignment");
+		//Neither the old row nor the old rejection may turn this one away
+		check(C.addUnverifiedMsg(sys, false, t + 2, point(sys, f2, t + 2, selfID), C),
+			  "point for the new commitment after assignment");
+		check(addPoints(sys, C, f2, t, selfID), "more points for the new commitment");
+		check(C.verifyShares(sys, selfID, false, nodes, subshares),
+			  "row of the new commitment after assignment");
+
+		//And a row that is not the new one's must fail
+		C = C2;
+		check(addPoints(sys, C, f1, t + 1, selfID), "points for the old commitment");
+		check(!C.verifyShares(sys, selfID, false, nodes, subshares),
+			  "row of the old commitment after assignment");
+	}
+
+	cout << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
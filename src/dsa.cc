@@ -0,0 +1,165 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#include <string.h>
+#include "dsa.h"
+
+DSASigner::DSASigner(gcry_mpi_t p, gcry_mpi_t q, gcry_mpi_t g, gcry_mpi_t x)
+	: p(p), q(q), g(g), x(x), background(true), started(false), stopping(false){
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+}
+
+DSASigner::~DSASigner(){
+	stop_filler();
+	while (!nonces.empty()) {
+		gcry_mpi_release(nonces.front().r);
+		gcry_mpi_release(nonces.front().kinv);
+		nonces.pop();
+	}
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&cond);
+	gcry_mpi_release(p);
+	gcry_mpi_release(q);
+	gcry_mpi_release(g);
+	gcry_mpi_release(x);
+}
+
+DSASigner::nonce DSASigner::make_nonce() const{
+	nonce n;
+	n.r = gcry_mpi_new(0);
+	n.kinv = gcry_mpi_new(0);
+	gcry_mpi_t k = gcry_mpi_new(0);
+	do {
+		//64 extra bits make k mod q close to uniform
+		gcry_mpi_randomize(k, gcry_mpi_get_nbits(q) + 64, GCRY_STRONG_RANDOM);
+		gcry_mpi_mod(k, k, q);
+		gcry_mpi_powm(n.r, g, k, p);
+		gcry_mpi_mod(n.r, n.r, q);
+	} while (!gcry_mpi_cmp_ui(k, 0) || !gcry_mpi_cmp_ui(n.r, 0));
+	gcry_mpi_invm(n.kinv, k, q);
+	gcry_mpi_release(k);
+	return n;
+}
+
+void DSASigner::set_background(bool on){
+	background = on;
+	if (!on) stop_filler();
+}
+
+void DSASigner::stop_filler(){
+	if (!started) return;
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mutex);
+	pthread_join(thread, NULL);
+	started = stopping = false;
+}
+
+void *DSASigner::launch_filler(void *arg){
+	((DSASigner *)arg)->filler();
+	return NULL;
+}
+
+void DSASigner::filler(){
+	pthread_mutex_lock(&mutex);
+	while (!stopping) {
+		if (nonces.size() >= DSA_NONCE_POOL) {
+			pthread_cond_wait(&cond, &mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&mutex);
+		nonce n = make_nonce();
+		pthread_mutex_lock(&mutex);
+		nonces.push(n);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void DSASigner::sign(const unsigned char *data, size_t len, unsigned char *sig){
+	nonce n;
+	bool have = false;
+	if (background && !started) {
+		started = true;
+		pthread_create(&thread, NULL, launch_filler, this);
+	}
+	pthread_mutex_lock(&mutex);
+	if (!nonces.empty()) {
+		n = nonces.front();
+		nonces.pop();
+		have = true;
+		pthread_cond_signal(&cond);
+	}
+	pthread_mutex_unlock(&mutex);
+	//The pool ran dry; don't wait for the filler
+	if (!have) n = make_nonce();
+
+	unsigned char hashbuf[20];
+	gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, data, len);
+	gcry_mpi_t s;
+	gcry_mpi_scan(&s, GCRYMPI_FMT_USG, hashbuf, 20, NULL);
+	gcry_mpi_t xr = gcry_mpi_new(0);
+	gcry_mpi_mulm(xr, x, n.r, q);
+	gcry_mpi_addm(s, s, xr, q);
+	gcry_mpi_mulm(s, s, n.kinv, q);
+	gcry_mpi_release(xr);
+
+	size_t nr, ns;
+	gcry_mpi_print(GCRYMPI_FMT_USG, NULL, 0, &nr, n.r);
+	gcry_mpi_print(GCRYMPI_FMT_USG, NULL, 0, &ns, s);
+	memset(sig, 0, 40);
+	gcry_mpi_print(GCRYMPI_FMT_USG, sig+(20-nr), nr, NULL, n.r);
+	gcry_mpi_print(GCRYMPI_FMT_USG, sig+20+(20-ns), ns, NULL, s);
+	gcry_mpi_release(n.r);
+	gcry_mpi_release(n.kinv);
+	gcry_mpi_release(s);
+}
+
+int dsa_verify(gcry_sexp_t pubkey, const unsigned char *data, size_t len,
+	const unsigned char *sig)
+{
+    // First hash the data
+    unsigned char hashbuf[20];
+    gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, data, len);
+
+    // Make an mpi out of the hash
+    gcry_mpi_t hashm;
+    gcry_mpi_scan(&hashm, GCRYMPI_FMT_USG, hashbuf, 20, NULL);
+
+    // Make an sexp out of the mpi
+    gcry_sexp_t hashs;
+    gcry_sexp_build(&hashs, NULL, "(%m)", hashm);
+    gcry_mpi_release(hashm);
+// Make mpis out of the signature
+    gcry_mpi_t r, s;
+    gcry_mpi_scan(&r, GCRYMPI_FMT_USG, sig, 20, NULL);
+    gcry_mpi_scan(&s, GCRYMPI_FMT_USG, sig+20, 20, NULL);
+
+    // Make an sexp for the signature
+    gcry_sexp_t sigs;
+    gcry_sexp_build(&sigs, NULL, "(sig-val (dsa (r %m)(s %m)))", r, s);
+    gcry_mpi_release(r);
+    gcry_mpi_release(s);
+
+    // Verify the signature
+    gcry_error_t vrf = gcry_pk_verify(sigs, hashs, pubkey);
+    gcry_sexp_release(sigs);
+    gcry_sexp_release(hashs);
+
+    return vrf ? -1 : 0;
+}
@@ -0,0 +1,69 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#ifndef __DSA_H__
+#define __DSA_H__
+
+#include <pthread.h>
+#include <queue>
+#include <gcrypt.h>
+
+using namespace std;
+
+//Nonces kept ready by DSASigner
+#define DSA_NONCE_POOL 256
+
+//DSA signatures (r, s) on the SHA-1 hash of the data, 20 bytes each. From
+//the first signature on, a background thread keeps a pool of nonces k with
+//r = (g^k mod p) mod q and k^-1 mod q, so that signing is
+//s = k^-1 (H(m) + x r) mod q. Each nonce is used for one signature only.
+class DSASigner {
+public:
+  //Takes over the mpis
+  DSASigner(gcry_mpi_t p, gcry_mpi_t q, gcry_mpi_t g, gcry_mpi_t x);
+  ~DSASigner();
+  void sign(const unsigned char *data, size_t len, unsigned char *sig);
+  //Off, the background thread is stopped and, once the pool is used up,
+  //each nonce is made in sign() on the caller's thread; for a simulation,
+  //which charges each node the CPU time it uses
+  void set_background(bool on);
+
+private:
+  DSASigner(const DSASigner&);
+  DSASigner& operator=(const DSASigner&);
+
+  struct nonce {
+	gcry_mpi_t r, kinv;
+  };
+  nonce make_nonce() const;
+
+  gcry_mpi_t p, q, g, x;
+  queue <nonce> nonces;
+  bool background, started, stopping;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_t thread;
+
+  void stop_filler();
+  static void *launch_filler(void *arg);
+  void filler();
+};
+
+//0 if sig is a good DSA signature on data under pubkey, -1 otherwise
+int dsa_verify(gcry_sexp_t pubkey, const unsigned char *data, size_t len,
+	const unsigned char *sig);
+#endif
@@ -0,0 +1,189 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+
+#include <map>
+#include <string.h>
+#include "ed25519.h"
+
+//Group order L = 2^252 + 27742317777372353535851937790883648493
+static const char *ED25519_ORDER =
+	"1000000000000000000000000000000014DEF9DEA2F79CD65812631A5CF5D3ED";
+
+//Ed25519 encodes scalars little endian; libgcrypt MPIs are big endian
+static gcry_mpi_t scan_le(const unsigned char *buf, size_t len){
+	unsigned char be[len];
+	for (size_t i = 0; i < len; ++i) be[i] = buf[len - 1 - i];
+	gcry_mpi_t m;
+	gcry_mpi_scan(&m, GCRYMPI_FMT_USG, be, len, NULL);
+	return m;
+}
+
+static gcry_sexp_t data_sexp(const unsigned char *data, size_t len){
+	gcry_sexp_t datas;
+	gcry_sexp_build(&datas, NULL, "(data(flags eddsa)(hash-algo sha512)(value %b))",
+					(int)len, data);
+	return datas;
+}
+
+gcry_sexp_t ed25519_privkey(const string& seed, const string& pubkey){
+	gcry_sexp_t key;
+	gcry_sexp_build(&key, NULL, "(private-key(ecc(curve Ed25519)(flags eddsa)(q %b)(d %b)))",
+					(int)pubkey.size(), pubkey.data(), (int)seed.size(), seed.data());
+	return key;
+}
+
+void ed25519_sign(gcry_sexp_t privkey, const unsigned char *data, size_t len,
+				  unsigned char *sig){
+	gcry_sexp_t datas = data_sexp(data, len);
+	gcry_sexp_t sigs;
+	memset(sig, 0, ED25519_SIG_SIZE);
+	if (gcry_pk_sign(&sigs, datas, privkey)) {gcry_sexp_release(datas); return;}
+	gcry_sexp_release(datas);
+	
+	// r and s are 32 byte little endian strings
+	const char *parts[2] = {"r", "s"};
+	for (int i = 0; i < 2; ++i){
+		gcry_sexp_t part = gcry_sexp_find_token(sigs, parts[i], 0);
+		size_t partlen;
+		const char *buf = gcry_sexp_nth_data(part, 1, &partlen);
+		if (buf && partlen <= 32) memcpy(sig + 32*i + (32 - partlen), buf, partlen);
+		gcry_sexp_release(part);
+	}
+	gcry_sexp_release(sigs);
+}
+
+//The same equation as a batch, so that whether a signature with small
+//order parts is taken does not depend on how it is checked
+int ed25519_verify(const string& pubkey, const unsigned char *data, size_t len,
+				   const unsigned char *sig){
+	Ed25519Batch batch;
+	batch.add(pubkey, data, len, sig);
+	return batch.verify() ? 0 : -1;
+}
+
+void Ed25519Batch::add(const string& pubkey, const unsigned char *data, size_t len,
+					   const unsigned char *sig){
+	entry e = {pubkey, data, len, sig};
+	entries.push_back(e);
+}
+
+static bool decode_point(gcry_mpi_point_t point, const unsigned char *buf, gcry_ctx_t ctx){
+	gcry_mpi_t value = gcry_mpi_set_opaque_copy(NULL, buf, 8*32);
+	gpg_error_t err = gcry_mpi_ec_decode_point(point, value, ctx);
+	gcry_mpi_release(value);
+	return !err;
+}
+
+bool Ed25519Batch::verify() const{
+	if (entries.empty()) return true;
+
+	gcry_ctx_t ctx;
+	if (gcry_mpi_ec_new(&ctx, NULL, "Ed25519")) return false;
+	gcry_mpi_t order;
+	gcry_mpi_scan(&order, GCRYMPI_FMT_HEX, ED25519_ORDER, 0, NULL);
+	gcry_mpi_t sSum = gcry_mpi_new(0);
+	gcry_mpi_t term = gcry_mpi_new(0);
+	gcry_mpi_point_t sum = gcry_mpi_point_new(0);
+	gcry_mpi_point_t point = gcry_mpi_point_new(0);
+	gcry_mpi_point_t scaled = gcry_mpi_point_new(0);
+	//Neutral element (0,1); term is still zero
+	gcry_mpi_point_set(sum, term, GCRYMPI_CONST_ONE, GCRYMPI_CONST_ONE);
+	map <string, gcry_mpi_t> keyScalars;
+	bool valid = true;
+
+	for (size_t i = 0; valid && i < entries.size(); ++i){
+		const entry& e = entries[i];
+		if (e.pubkey.size() != ED25519_KEY_SIZE) {valid = false; break;}
+		//A single signature is checked exactly, with z = 1
+		gcry_mpi_t z;
+		if (entries.size() == 1) z = gcry_mpi_set_ui(NULL, 1);
+		else {
+			unsigned char zbuf[16];
+			gcry_create_nonce(zbuf, sizeof(zbuf));
+			gcry_mpi_scan(&z, GCRYMPI_FMT_USG, zbuf, sizeof(zbuf), NULL);
+		}
+
+		//s must be reduced
+		gcry_mpi_t s = scan_le(e.sig + 32, 32);
+		if (gcry_mpi_cmp(s, order) >= 0) valid = false;
+		gcry_mpi_mulm(term, z, s, order);
+		gcry_mpi_addm(sSum, sSum, term, order);
+		gcry_mpi_release(s);
+
+		//z_i R_i
+		if (valid && decode_point(point, e.sig, ctx)){
+			gcry_mpi_ec_mul(scaled, z, point, ctx);
+			gcry_mpi_ec_add(sum, sum, scaled, ctx);
+		} else valid = false;
+
+		//h_i = SHA512(R || A || M) mod L, collected per key
+		string hashInput((const char *)e.sig, 32);
+		hashInput.append(e.pubkey);
+		hashInput.append((const char *)e.data, e.len);
+		unsigned char digest[64];
+		gcry_md_hash_buffer(GCRY_MD_SHA512, digest, hashInput.data(), hashInput.size());
+		gcry_mpi_t h = scan_le(digest, 64);
+		gcry_mpi_mod(h, h, order);
+		gcry_mpi_mulm(term, z, h, order);
+		gcry_mpi_release(h);
+		gcry_mpi_release(z);
+		map <string, gcry_mpi_t>::iterator it = keyScalars.find(e.pubkey);
+		if (it == keyScalars.end()) 
+			keyScalars.insert(make_pair(e.pubkey, gcry_mpi_copy(term)));
+		else gcry_mpi_addm(it->second, it->second, term, order);
+	}
+
+	//sum (z_i h_i) A_i, one multiplication per key
+	map <string, gcry_mpi_t>::iterator it;
+	for (it = keyScalars.begin(); it != keyScalars.end(); ++it){
+		if (valid && decode_point(point, (const unsigned char *)it->first.data(), ctx)){
+			gcry_mpi_ec_mul(scaled, it->second, point, ctx);
+			gcry_mpi_ec_add(sum, sum, scaled, ctx);
+		} else valid = false;
+		gcry_mpi_release(it->second);
+	}
+
+	if (valid){
+		//Subtract (sum z_i s_i) B and clear the cofactor
+		gcry_mpi_point_t base = gcry_mpi_ec_get_point("g", ctx, 1);
+		gcry_mpi_sub(term, order, sSum);
+		gcry_mpi_ec_mul(scaled, term, base, ctx);
+		gcry_mpi_ec_add(sum, sum, scaled, ctx);
+		gcry_mpi_point_release(base);
+		gcry_mpi_t eight = gcry_mpi_set_ui(NULL, 8);
+		gcry_mpi_ec_mul(scaled, eight, sum, ctx);
+		gcry_mpi_release(eight);
+
+		gcry_mpi_t x = gcry_mpi_new(0), y = gcry_mpi_new(0);
+		valid = !gcry_mpi_ec_get_affine(x, y, scaled, ctx) && 
+				!gcry_mpi_cmp_ui(x, 0) && !gcry_mpi_cmp_ui(y, 1);
+		gcry_mpi_release(x);
+		gcry_mpi_release(y);
+	}
+
+	gcry_mpi_point_release(sum);
+	gcry_mpi_point_release(point);
+	gcry_mpi_point_release(scaled);
+	gcry_mpi_release(sSum);
+	gcry_mpi_release(term);
+	gcry_mpi_release(order);
+	gcry_ctx_release(ctx);
+	return valid;
+}
@@ -0,0 +1,65 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#ifndef __ED25519_H__
+#define __ED25519_H__
+
+#include <string>
+#include <vector>
+#include <gcrypt.h>
+
+using namespace std;
+
+#define ED25519_KEY_SIZE 32
+#define ED25519_SIG_SIZE 64
+
+//Build the libgcrypt private key from the 32 byte seed and public key
+gcry_sexp_t ed25519_privkey(const string& seed, const string& pubkey);
+
+void ed25519_sign(gcry_sexp_t privkey, const unsigned char *data, size_t len,
+				  unsigned char *sig);
+
+//0 if sig is a good signature on data under pubkey, -1 otherwise. Uses the
+//cofactored equation [8](s B) == [8](R + h A), as Ed25519Batch does.
+int ed25519_verify(const string& pubkey, const unsigned char *data, size_t len,
+				   const unsigned char *sig);
+
+//Signatures collected for one batch check. The data and signature pointers
+//must stay valid until verify() is called.
+class Ed25519Batch {
+public:
+  void add(const string& pubkey, const unsigned char *data, size_t len,
+		   const unsigned char *sig);
+  size_t size() const {return entries.size();}
+  //Check all signatures at once: with random 128 bit z_i (1 for a single one),
+  //[8]((sum z_i s_i) B) == [8](sum z_i R_i + sum (z_i h_i) A_i).
+  //The A_i terms of a key that signed several times are added up first.
+  //A false result means at least one signature is bad.
+  bool verify() const;
+  
+private:
+  struct entry {
+	string pubkey;
+	const unsigned char *data;
+	size_t len;
+	const unsigned char *sig;
+  };
+  vector <entry> entries;
+};
+#endif
@@ -0,0 +1,215 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+//Checks Ed25519Batch against single verification: a batch of good
+//signatures passes, one with a bad s, a bad R or the wrong key fails it,
+//and a signature whose R has a small order part gets the same answer alone
+//and in a batch.
+//Usage: ed25519test [signatures]
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ed25519.h"
+
+//A point of order 8
+static const char *TORSION_POINT =
+	"26e8958fc2b227b045c3f489f2ef98f0d5dfac05d3c63339b13802886d53fc05";
+
+static void make_key(string& seed, string& pubkey)
+{
+	gcry_sexp_t params, key;
+	gcry_sexp_build(&params, NULL, "(genkey(ecc(curve Ed25519)(flags eddsa)))");
+	gcry_pk_genkey(&key, params);
+	gcry_sexp_release(params);
+	gcry_sexp_t q = gcry_sexp_find_token(key, "q", 0);
+	gcry_sexp_t d = gcry_sexp_find_token(key, "d", 0);
+	size_t qlen, dlen;
+	const char *qbuf = gcry_sexp_nth_data(q, 1, &qlen);
+	const char *dbuf = gcry_sexp_nth_data(d, 1, &dlen);
+	pubkey.assign(qbuf + qlen - ED25519_KEY_SIZE, ED25519_KEY_SIZE);
+	seed.assign(dbuf, dlen);
+	gcry_sexp_release(q);
+	gcry_sexp_release(d);
+	gcry_sexp_release(key);
+}
+
+static bool decode(gcry_mpi_point_t point, const unsigned char *buf, gcry_ctx_t ctx)
+{
+	gcry_mpi_t value = gcry_mpi_set_opaque_copy(NULL, buf, 8*32);
+	gpg_error_t err = gcry_mpi_ec_decode_point(point, value, ctx);
+	gcry_mpi_release(value);
+	return !err;
+}
+
+static gcry_mpi_t scan_le(const unsigned char *buf, size_t len)
+{
+	unsigned char be[64];
+	for (size_t i = 0; i < len; ++i) be[i] = buf[len - 1 - i];
+	gcry_mpi_t m;
+	gcry_mpi_scan(&m, GCRYMPI_FMT_USG, be, len, NULL);
+	return m;
+}
+
+static void print_le(unsigned char *buf, gcry_mpi_t m)
+{
+	unsigned char be[32];
+	size_t written;
+	memset(be, 0, sizeof(be));
+	gcry_mpi_print(GCRYMPI_FMT_USG, be, 32, &written, m);
+	for (size_t i = 0; i < written; ++i) buf[i] = be[written - 1 - i];
+	memset(buf + written, 0, 32 - written);
+}
+
+//Sign with R' = rB + T for T of order 8, and s = r + H(R' || A || msg) a.
+//[8](s B) == [8](R' + h A) holds, but s B == R' + h A does not.
+static bool sign_with_torsion(const string& seed, const string& pubkey,
+							  const string& msg, unsigned char *sig)
+{
+	gcry_ctx_t ctx;
+	if (gcry_mpi_ec_new(&ctx, NULL, "Ed25519")) return false;
+	gcry_mpi_t order = gcry_mpi_ec_get_mpi("n", ctx, 1);
+
+	//The secret scalar a, as in RFC 8032
+	unsigned char digest[64];
+	gcry_md_hash_buffer(GCRY_MD_SHA512, digest, seed.data(), seed.size());
+	digest[0] &= 248;
+	digest[31] &= 127;
+	digest[31] |= 64;
+	gcry_mpi_t a = scan_le(digest, 32);
+
+	unsigned char rbuf[32];
+	gcry_create_nonce(rbuf, sizeof(rbuf));
+	gcry_mpi_t r = scan_le(rbuf, 32);
+	gcry_mpi_mod(r, r, order);
+
+	unsigned char tbuf[32];
+	for (int i = 0; i < 32; ++i) sscanf(TORSION_POINT + 2*i, "%2hhx", &tbuf[i]);
+	gcry_mpi_point_t base = gcry_mpi_ec_get_point("g", ctx, 1);
+	gcry_mpi_point_t R = gcry_mpi_point_new(0), t = gcry_mpi_point_new(0);
+	gcry_mpi_ec_mul(R, r, base, ctx);
+	bool ok = decode(t, tbuf, ctx);
+	if (ok) {
+		gcry_mpi_ec_add(R, R, t, ctx);
+		gcry_mpi_ec_set_point("q", R, ctx);
+		gcry_mpi_t enc = gcry_mpi_ec_get_mpi("q@eddsa", ctx, 1);
+		unsigned int nbits;
+		const unsigned char *encbuf = (const unsigned char *)gcry_mpi_get_opaque(enc, &nbits);
+		ok = encbuf && nbits == 8*32;
+		if (ok) memcpy(sig, encbuf, 32);
+		gcry_mpi_release(enc);
+	}
+	if (ok) {
+		string hashInput((const char *)sig, 32);
+		hashInput.append(pubkey);
+		hashInput.append(msg);
+		gcry_md_hash_buffer(GCRY_MD_SHA512, digest, hashInput.data(), hashInput.size());
+		gcry_mpi_t h = scan_le(digest, 64);
+		gcry_mpi_mod(h, h, order);
+		gcry_mpi_mulm(h, h, a, order);
+		gcry_mpi_addm(h, h, r, order);
+		print_le(sig + 32, h);
+		gcry_mpi_release(h);
+	}
+	gcry_mpi_point_release(R);
+	gcry_mpi_point_release(t);
+	gcry_mpi_point_release(base);
+	gcry_mpi_release(a);
+	gcry_mpi_release(r);
+	gcry_mpi_release(order);
+	gcry_ctx_release(ctx);
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? atoi(argv[1]) : 40;
+	if (count < 2) count = 2;
+	gcry_check_version(NULL);
+
+	const int nkeys = 4;
+	string seeds[nkeys], pubkeys[nkeys];
+	gcry_sexp_t privkeys[nkeys];
+	for (int k = 0; k < nkeys; ++k) {
+		make_key(seeds[k], pubkeys[k]);
+		privkeys[k] = ed25519_privkey(seeds[k], pubkeys[k]);
+	}
+
+	vector<string> msgs;
+	vector<unsigned char> sigbuf(count * ED25519_SIG_SIZE);
+	unsigned char *sigs = &sigbuf[0];
+	int failures = 0;
+	for (size_t i = 0; i < count; ++i) {
+		char msg[32];
+		sprintf(msg, "message %d", (int)(i % 7));
+		msgs.push_back(msg);
+		unsigned char *sig = sigs + i * ED25519_SIG_SIZE;
+		ed25519_sign(privkeys[i % nkeys], (const unsigned char *)msgs[i].data(),
+					 msgs[i].size(), sig);
+		if (ed25519_verify(pubkeys[i % nkeys], (const unsigned char *)msgs[i].data(),
+						   msgs[i].size(), sig)) {
+			cout << "signature " << i << " fails on its own" << endl;
+			++failures;
+		}
+	}
+
+	//keyShift picks the wrong key for every signature
+	size_t bad = count / 2;
+	struct {const char *name; size_t byte; int keyShift; bool expect;} cases[] = {
+		{"good", 0, 0, true},
+		{"bad s", 32 + 5, 0, false},
+		{"bad R", 3, 0, false},
+		{"wrong key", 0, 1, false},
+	};
+	for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+		unsigned char *sig = sigs + bad * ED25519_SIG_SIZE;
+		if (cases[c].byte) sig[cases[c].byte] ^= 1;
+		Ed25519Batch batch;
+		for (size_t i = 0; i < count; ++i)
+			batch.add(pubkeys[(i + cases[c].keyShift) % nkeys],
+					  (const unsigned char *)msgs[i].data(), msgs[i].size(),
+					  sigs + i * ED25519_SIG_SIZE);
+		bool result = batch.verify();
+		if (cases[c].byte) sig[cases[c].byte] ^= 1;
+		cout << cases[c].name << ": " << (result ? "accepted" : "rejected") << endl;
+		if (result != cases[c].expect) ++failures;
+	}
+
+	//R with a small order part: a single check and a batch must agree
+	unsigned char *sig = sigs + bad * ED25519_SIG_SIZE;
+	if (!sign_with_torsion(seeds[bad % nkeys], pubkeys[bad % nkeys], msgs[bad], sig)) {
+		cout << "could not add a small order point" << endl;
+		++failures;
+	} else {
+		const string& pubkey = pubkeys[bad % nkeys];
+		bool single = !ed25519_verify(pubkey, (const unsigned char *)msgs[bad].data(),
+									  msgs[bad].size(), sig);
+		Ed25519Batch batch;
+		for (size_t i = 0; i < count; ++i)
+			batch.add(pubkeys[i % nkeys], (const unsigned char *)msgs[i].data(),
+					  msgs[i].size(), sigs + i * ED25519_SIG_SIZE);
+		bool batched = batch.verify();
+		cout << "small order R: " << (single ? "accepted" : "rejected") << " alone, "
+			 << (batched ? "accepted" : "rejected") << " in a batch" << endl;
+		if (single != batched) ++failures;
+	}
+
+	for (int k = 0; k < nkeys; ++k) gcry_sexp_release(privkeys[k]);
+	cout << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
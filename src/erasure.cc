@@ -0,0 +1,178 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include <gcrypt.h>
+#include "erasure.h"
+
+//GF(2^8) modulo x^8+x^4+x^3+x^2+1, through log and antilog tables
+static unsigned char gfExp[512];
+static unsigned char gfLog[256];
+
+static void gf_init(){
+	if (gfExp[0]) return;
+	unsigned int x = 1;
+	for (int i = 0; i < 255; ++i){
+		gfExp[i] = gfExp[i + 255] = (unsigned char)x;
+		gfLog[x] = (unsigned char)i;
+		x <<= 1;
+		if (x & 0x100) x ^= 0x11d;
+	}
+}
+
+static unsigned char gf_mul(unsigned char a, unsigned char b){
+	if (!a || !b) return 0;
+	return gfExp[gfLog[a] + gfLog[b]];
+}
+
+static unsigned char gf_div(unsigned char a, unsigned char b){
+	if (!a) return 0;
+	return gfExp[gfLog[a] + 255 - gfLog[b]];
+}
+
+//out = the fragment at point x, interpolated bytewise from the fragments at points xs
+static void interpolate(const vector<unsigned int> &xs, const vector<const string*> &ys,
+						unsigned int x, size_t fraglen, string &out){
+	out.assign(fraglen, '\0');
+	unsigned char *dst = (unsigned char *)&out[0];
+	unsigned char row[256];
+	for (size_t i = 0; i < xs.size(); ++i){
+		unsigned char num = 1, den = 1;
+		for (size_t m = 0; m < xs.size(); ++m){
+			if (m == i) continue;
+			num = gf_mul(num, (unsigned char)(x ^ xs[m]));
+			den = gf_mul(den, (unsigned char)(xs[i] ^ xs[m]));
+		}
+		unsigned char c = gf_div(num, den);
+		if (!c) continue;
+		//One multiplication table per coefficient
+		for (int b = 0; b < 256; ++b) row[b] = gf_mul(c, (unsigned char)b);
+		const unsigned char *src = (const unsigned char *)ys[i]->data();
+		for (size_t j = 0; j < fraglen; ++j) dst[j] ^= row[src[j]];
+	}
+}
+
+vector<string> rs_encode(const string &data, unsigned int k, unsigned int count){
+	gf_init();
+	vector<string> fragments;
+	if (!k || k > count || count > FRAGMENT_MAX_COUNT) return fragments;
+	size_t fraglen = (data.length() + k - 1) / k;
+	if (!fraglen) fraglen = 1;
+	for (unsigned int i = 0; i < k; ++i){
+		fragments.push_back(i * fraglen < data.length() ? data.substr(i * fraglen, fraglen) : string());
+		fragments.back().resize(fraglen, '\0');
+	}
+	vector<unsigned int> xs;
+	vector<const string*> ys;
+	for (unsigned int i = 0; i < k; ++i){
+		xs.push_back(i);
+		ys.push_back(&fragments[i]);
+	}
+	vector<string> parity(count - k);
+	for (unsigned int i = k; i < count; ++i)
+		interpolate(xs, ys, i, fraglen, parity[i - k]);
+	fragments.insert(fragments.end(), parity.begin(), parity.end());
+	return fragments;
+}
+
+bool rs_decode(const map<unsigned int, string> &fragments, unsigned int k,
+			   unsigned int length, string &data){
+	gf_init();
+	if (!k || fragments.size() < k) return false;
+	vector<unsigned int> xs;
+	vector<const string*> ys;
+	map<unsigned int, string>::const_iterator it;
+	for (it = fragments.begin(); it != fragments.end() && xs.size() < k; ++it){
+		if (it->first >= FRAGMENT_MAX_COUNT) return false;
+		if (ys.size() && it->second.length() != ys.front()->length()) return false;
+		xs.push_back(it->first);
+		ys.push_back(&it->second);
+	}
+	size_t fraglen = ys.front()->length();
+	if ((size_t)length > fraglen * k) return false;
+
+	data.clear();
+	string missing;
+	for (unsigned int i = 0; i < k && data.length() < length; ++i){
+		it = fragments.find(i);
+		if (it != fragments.end()) {
+			data.append(it->second);
+		} else {
+			interpolate(xs, ys, i, fraglen, missing);
+			data.append(missing);
+		}
+	}
+	data.resize(length);
+	return true;
+}
+
+//Leaves and inner nodes are domain separated, as in commitmentvector.cc.
+//A node without a sibling is carried up to the next level unchanged.
+static string fragment_hash(unsigned char tag, const string &left, const string &right = string()){
+	string str(1, (char)tag);
+	str.append(left);str.append(right);
+	unsigned char hashbuf[FRAGMENT_HASH_SIZE];
+	gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, str.data(), str.length());
+	return string((const char*)hashbuf, FRAGMENT_HASH_SIZE);
+}
+
+static string fragment_bind(const string &top, unsigned int count, unsigned int length){
+	string params;
+	for (int shift = 24; shift >= 0; shift -= 8) params.push_back((char)(count >> shift));
+	for (int shift = 24; shift >= 0; shift -= 8) params.push_back((char)(length >> shift));
+	return fragment_hash(2, params, top);
+}
+
+string fragment_root(const vector<string> &fragments, unsigned int length,
+					 vector<vector<string> > *proofs){
+	vector<string> level;
+	for (size_t i = 0; i < fragments.size(); ++i)
+		level.push_back(fragment_hash(0, fragments[i]));
+	if (proofs) proofs->assign(fragments.size(), vector<string>());
+
+	size_t span = 1;//Leaves under each node of the current level
+	while (level.size() > 1){
+		if (proofs)
+			for (size_t i = 0; i < fragments.size(); ++i){
+				size_t pos = i / span;
+				if ((pos ^ 1) < level.size()) (*proofs)[i].push_back(level[pos ^ 1]);
+			}
+		vector<string> next;
+		for (size_t i = 0; i + 1 < level.size(); i += 2)
+			next.push_back(fragment_hash(1, level[i], level[i + 1]));
+		if (level.size() % 2) next.push_back(level.back());
+		level.swap(next);
+		span *= 2;
+	}
+	return fragment_bind(level.empty() ? string() : level[0], fragments.size(), length);
+}
+
+bool fragment_check(const string &root, unsigned int count, unsigned int length,
+					unsigned int index, const string &fragment,
+					const vector<string> &proof){
+	if (index >= count || count > FRAGMENT_MAX_COUNT) return false;
+	string hash = fragment_hash(0, fragment);
+	size_t used = 0;
+	for (unsigned int pos = index, size = count; size > 1; pos /= 2, size = (size + 1) / 2){
+		if (pos % 2 == 0 && pos + 1 == size) continue;
+		if (used == proof.size()) return false;
+		if (pos % 2) hash = fragment_hash(1, proof[used++], hash);
+		else hash = fragment_hash(1, hash, proof[used++]);
+	}
+	return used == proof.size() && fragment_bind(hash, count, length) == root;
+}
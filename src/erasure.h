@@ -0,0 +1,52 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#ifndef __ERASURE_H__
+#define __ERASURE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//Reed-Solomon coding over GF(2^8) for spreading a commitment over the nodes.
+//The buffer is cut into k fragments and extended to count fragments, any k
+//of which give it back. Fragment i is the value at point i, so the first k
+//fragments are the buffer itself.
+#define FRAGMENT_MAX_COUNT 256
+#define FRAGMENT_HASH_SIZE 32
+//Depth of a Merkle tree over FRAGMENT_MAX_COUNT leaves
+#define FRAGMENT_MAX_PROOF 8
+
+vector<string> rs_encode(const string &data, unsigned int k, unsigned int count);
+
+//Put the buffer of the given length back together from k of its fragments
+bool rs_decode(const map<unsigned int, string> &fragments, unsigned int k,
+			   unsigned int length, string &data);
+
+//The root names a set of fragments: a Merkle tree over them, bound to their
+//number and the length of the buffer. proofs gets the authentication path
+//of every fragment.
+string fragment_root(const vector<string> &fragments, unsigned int length,
+					 vector<vector<string> > *proofs = NULL);
+
+bool fragment_check(const string &root, unsigned int count, unsigned int length,
+					unsigned int index, const string &fragment,
+					const vector<string> &proof);
+
+#endif
@@ -0,0 +1,106 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+//Checks the erasure coding of commitments: random buffers are decoded from
+//random subsets of k fragments, every fragment's proof checks out and fails
+//for a tampered fragment, a wrong index, count or length, and a buffer
+//decoded from a tampered fragment is caught by re-encoding it and comparing
+//the root, as Node::assembleCommitment does.
+//Usage: erasuretest [trials]
+
+#include <iostream>
+#include <stdlib.h>
+#include "erasure.h"
+
+static bool run(unsigned int count, unsigned int k, unsigned int length)
+{
+	string data;
+	for (unsigned int i = 0; i < length; ++i) data.push_back((char)rand());
+	vector<string> fragments = rs_encode(data, k, count);
+	vector<vector<string> > proofs;
+	string root = fragment_root(fragments, length, &proofs);
+	if (fragments.size() != count || proofs.size() != count) return false;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!fragment_check(root, count, length, i, fragments[i], proofs[i]))
+			return false;
+		//Wrong index, count or length
+		unsigned int other = (i + 1) % count;
+		if (count > 1 && fragments[other] != fragments[i] &&
+			fragment_check(root, count, length, other, fragments[i], proofs[i]))
+			return false;
+		if (fragment_check(root, count + 1, length, i, fragments[i], proofs[i]))
+			return false;
+		if (fragment_check(root, count, length + 1, i, fragments[i], proofs[i]))
+			return false;
+		//Tampered fragment
+		if (fragments[i].size()) {
+			string tampered = fragments[i];
+			tampered[rand() % tampered.size()] ^= 1 + rand() % 255;
+			if (fragment_check(root, count, length, i, tampered, proofs[i]))
+				return false;
+		}
+	}
+
+	//Any k fragments give the buffer back
+	vector<unsigned int> order;
+	for (unsigned int i = 0; i < count; ++i) order.push_back(i);
+	for (unsigned int i = 0; i < count; ++i) swap(order[i], order[rand() % count]);
+	map<unsigned int, string> picked;
+	for (unsigned int i = 0; i < k; ++i) picked[order[i]] = fragments[order[i]];
+	string decoded;
+	if (!rs_decode(picked, k, length, decoded) || decoded != data) return false;
+	if (fragment_root(rs_encode(decoded, k, count), length) != root) return false;
+
+	//Fewer than k are not enough
+	if (k > 1) {
+		map<unsigned int, string> fewer(picked);
+		fewer.erase(fewer.begin());
+		if (rs_decode(fewer, k, length, decoded)) return false;
+	}
+
+	//A tampered fragment decodes to something else, which re-encodes to
+	//another root
+	if (length) {
+		string &victim = picked.begin()->second;
+		if (victim.size()) {
+			victim[rand() % victim.size()] ^= 1 + rand() % 255;
+			if (rs_decode(picked, k, length, decoded) &&
+				fragment_root(rs_encode(decoded, k, count), length) == root)
+				return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int trials = argc > 1 ? atoi(argv[1]) : 300;
+	unsigned int failures = 0;
+	for (unsigned int trial = 0; trial < trials; ++trial) {
+		unsigned int count = 1 + rand() % FRAGMENT_MAX_COUNT;
+		unsigned int k = 1 + rand() % count;
+		unsigned int length = rand() % 20000;
+		if (!run(count, k, length)) {
+			cout << "failed: count " << count << " k " << k
+				 << " length " << length << endl;
+			++failures;
+		}
+	}
+	cout << trials << " trials: " << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
@@ -19,6 +19,14 @@
 
 #include "io.h"
 #include "exceptions.h"
+#include "sigpool.h"
+#include <map>
+#include <queue>
+#include <set>
+#include <pthread.h>
+
+//Bound on the bytes of G1 runs kept by read_G1s, for each SystemParam
+#define G1_CACHE_BYTES (16 << 20)
 
 void hexdump(FILE *f, const string &s)
 {
@@ -102,6 +110,60 @@ void read_G1(const unsigned char *&buf, size_t &len, G1 &elt, const Pairing& e)
   } else elt = G1();
 }
 
+void read_G1s(const unsigned char *&buf, size_t &len, vector<G1>& elts,
+			  NodeIDSize count, const SystemParam& sys)
+{
+  const Pairing &e = sys.get_Pairing();
+  //Find the extent of the run first
+  size_t eltlen = e.getElementSize(Type_G1,true);
+  size_t runlen = 0;
+  for(NodeIDSize i = 0; i < count; ++i){
+	if (len < runlen + 1) throw InvalidMessageException();
+	if (buf[runlen]) runlen += eltlen;
+	runlen += 1;
+	if (len < runlen) throw InvalidMessageException();
+  }
+  string key((const char*)buf, runlen);
+
+  G1RunCache &cache = sys.get_g1_cache();
+  pthread_mutex_lock(&cache.mutex);
+  map<string, vector<G1> >::const_iterator it = cache.runs.find(key);
+  if (it != cache.runs.end()) {
+	elts.insert(elts.end(), it->second.begin(), it->second.end());
+	pthread_mutex_unlock(&cache.mutex);
+	buf += runlen;
+	len -= runlen;
+	return;
+  }
+  pthread_mutex_unlock(&cache.mutex);
+  
+  vector<G1> run;
+  for(NodeIDSize i = 0; i < count; ++i){
+	G1 entry;
+	read_G1(buf, len, entry, e);
+	run.push_back(entry);
+  }
+  elts.insert(elts.end(), run.begin(), run.end());
+
+  size_t bytes = runlen + count * e.getElementSize(Type_G1, false);
+  if (bytes > G1_CACHE_BYTES) return;
+  pthread_mutex_lock(&cache.mutex);
+  if (cache.runs.count(key)) {
+	pthread_mutex_unlock(&cache.mutex);
+	return;
+  }
+  while (cache.bytes + bytes > G1_CACHE_BYTES && !cache.order.empty()){
+	map<string, vector<G1> >::iterator old = cache.runs.find(cache.order.front());
+	cache.bytes -= old->first.size() + old->second.size() * e.getElementSize(Type_G1, false);
+	cache.runs.erase(old);
+	cache.order.pop();
+  }
+  cache.runs.insert(make_pair(key, run));
+  cache.order.push(key);
+  cache.bytes += bytes;
+  pthread_mutex_unlock(&cache.mutex);
+}
+
 void write_Zr(string &body, const Zr& elt)
 {
   write_byte(body, elt.isElementPresent());
@@ -205,10 +267,16 @@ bool read_sig(const Buddy *buddy, const unsigned char *&buf, size_t &len,
     size_t sigsize = buddy->sig_size();
     if (len < sigsize) throw InvalidMessageException();
     
-    if (buddy->verify(signstart, signend-signstart, buf) < 0) 
+    SigCache &goodSigs = buddy->get_buddyset().get_sig_cache();
+    string key = SigCache::key(buddy->get_id(), signstart, signend-signstart, buf, sigsize);
+    if (goodSigs.has(key))
+	  status = true;
+    else if (buddy->verify(signstart, signend-signstart, buf) < 0) 
 	  status = false;
-	else 
+	else {
 	  status = true;
+	  goodSigs.add(key);
+	}
 	  //{throw InvalidSignatureException();}
     buf += sigsize;
     len -= sigsize;
@@ -218,13 +286,122 @@ bool read_sig(const Buddy *buddy, const unsigned char *&buf, size_t &len,
 void hash_msg(G1& elt, string msg, const Pairing& e)
 {
     unsigned char hashbuf[20];
-    //unsigned char idbuf[2];
-    //idbuf[0] = (id >> 8) & 0xff;
-    //idbuf[1] = (id) & 0xff;
-    gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, msg.data(), 2);
+    gcry_md_hash_buffer(GCRY_MD_SHA1, hashbuf, msg.data(), msg.size());
     elt = G1(e, (void*)hashbuf, 20);
 }
 
+void hash_signed(G1& elt, const unsigned char *data, size_t len, const Pairing& e,
+				 const string& domain)
+{
+    unsigned char hashbuf[32];
+    string buf(domain);
+    buf.push_back('\0');
+    buf.append((const char *)data, len);
+    gcry_md_hash_buffer(GCRY_MD_SHA256, hashbuf, buf.data(), buf.size());
+    elt = G1(e, (void*)hashbuf, 32);
+}
+
+void write_sigs(const SystemParam &sys, string &body, const map<NodeID, string>& sigs)
+{
+    map<NodeID, string>::const_iterator iter;
+    if (!sys.use_certificates()) {
+	write_us(body, (NodeIDSize)sigs.size());
+	for (iter = sigs.begin(); iter != sigs.end(); ++iter) {
+	    write_us(body, iter->first);
+	    body.append(iter->second);
+	}
+	return;
+    }
+    const Pairing& e = sys.get_Pairing();
+    string bitmap;
+    G1 aggregate(sys.get_U(), true);
+    for (iter = sigs.begin(); iter != sigs.end(); ++iter) {
+	size_t byte = iter->first / 8;
+	if (bitmap.size() <= byte) bitmap.resize(byte + 1, '\0');
+	bitmap[byte] |= 1 << (iter->first % 8);
+	if (iter->second.size())
+	    aggregate *= G1(e, (const unsigned char *)iter->second.data(),
+			    iter->second.size(), true);
+    }
+    write_us(body, (unsigned short)bitmap.size());
+    body.append(bitmap);
+    body.append(aggregate.toString(true));
+}
+
+bool read_sigs(const Buddy *buddy, const unsigned char *&buf, size_t &len,
+			   const unsigned char *signstart, const unsigned char *signend,
+			   map<NodeID, string>& sigs, SigJob *job)
+{
+    const SystemParam &sys = buddy->get_param();
+    if (!sys.use_certificates()) {
+	unsigned short size; read_us(buf, len, size);
+	for (unsigned short i = 0; i < size; ++i) {
+	    NodeID sender; read_us(buf, len, sender);
+	    const Buddy *signer = buddy->find_other_buddy(sender);
+	    if (!signer) return false;
+	    const unsigned char *sig = buf;
+	    if (job) {
+		size_t sigsize = signer->sig_size();
+		if (len < sigsize) throw InvalidMessageException();
+		string key = SigCache::key(sender, signstart, signend - signstart,
+					   buf, sigsize);
+		if (!buddy->get_buddyset().get_sig_cache().has(key))
+		    job->add(signer, signstart, signend - signstart, buf, key);
+		buf += sigsize;
+		len -= sigsize;
+	    } else if (!read_sig(signer, buf, len, signstart, signend)) return false;
+	    sigs.insert(make_pair(sender, string((const char *)sig, buf - sig)));
+	}
+	return true;
+    }
+    //Certificate: e(U, sig) == e(prod PK_i, H(msg))
+    const Pairing& e = sys.get_Pairing();
+    unsigned short bitmaplen; read_us(buf, len, bitmaplen);
+    string bitmap;
+    read_str(buf, len, bitmap, bitmaplen);
+    string sig;
+    read_str(buf, len, sig, buddy->sig_size());
+    G1 publicKeys(sys.get_U(), true);
+    for (size_t byte = 0; byte < bitmap.size(); ++byte)
+	for (unsigned int bit = 0; bit < 8; ++bit) {
+	    if (!(bitmap[byte] & (1 << bit))) continue;
+	    NodeID signer = byte * 8 + bit;
+	    const Buddy *signerBuddy = buddy->find_other_buddy(signer);
+	    if (!signerBuddy || !signerBuddy->got_bls_pubkey()) return false;
+	    publicKeys *= signerBuddy->get_bls_pubkey();
+	    sigs.insert(make_pair(signer, sigs.empty() ? sig : string()));
+	}
+    if (sigs.empty()) return false;
+    G1 msgHash;
+    hash_signed(msgHash, signstart, signend - signstart, e);
+    G1 aggregate(e, (const unsigned char *)sig.data(), sig.size(), true);
+    return e(sys.get_U(), aggregate) == e(publicKeys, msgHash);
+}
+
+bool verify_sigs(const SigJob& job)
+{
+    if (!job.check(0, job.size())) return false;
+    job.remember();
+    return true;
+}
+
+void merge_sigs(map<NodeID, string>& into, const map<NodeID, string>& from)
+{
+    bool aggregated = false, overlap = false;
+    map<NodeID, string>::const_iterator iter;
+    for (iter = from.begin(); iter != from.end(); ++iter) {
+	if (iter->second.empty()) aggregated = true;
+	if (into.count(iter->first)) overlap = true;
+    }
+    for (iter = into.begin(); iter != into.end(); ++iter)
+	if (iter->second.empty()) aggregated = true;
+    if (aggregated && overlap) {
+	if (from.size() > into.size()) into = from;
+	return;
+    }
+    into.insert(from.begin(), from.end());
+}
+
 void hash_id(G1& elt, NodeID id, const Pairing& e)
 {
     unsigned char hashbuf[20];
@@ -50,10 +50,36 @@ void write_sig(const BuddySet &buddyset, string &body, const string& msgStr);
 bool read_sig(const Buddy *buddy, const unsigned char *&buf, size_t &len,
 			 const unsigned char *signstart, const unsigned char *signend);
 
+//Signatures by several nodes on the same message: a count followed by
+//(signer, signature) pairs or, with certificates, a signer bitmap followed by
+//the product of the BLS signatures. A certificate read back is kept as the
+//product under its first signer and empty strings for the other signers.
+void write_sigs(const SystemParam &sys, string &body, const map<NodeID, string>& sigs);
+
+//With a job, signatures not in the cache are only collected there and the
+//caller has to check the job before trusting the result. Certificates are
+//always checked here.
+bool read_sigs(const Buddy *buddy, const unsigned char *&buf, size_t &len,
+			   const unsigned char *signstart, const unsigned char *signend,
+			   map<NodeID, string>& sigs, class SigJob *job = NULL);
+
+//Check a job filled by read_sigs and remember its signatures as good
+bool verify_sigs(const class SigJob& job);
+
+//Union of two signature sets; an aggregated set cannot be split, so when
+//it overlaps with the other set the larger one is kept
+void merge_sigs(map<NodeID, string>& into, const map<NodeID, string>& from);
+
 void write_G1(string &body, const G1& elt);
 
 void read_G1(const unsigned char *&buf, size_t &len, G1& elt, const Pairing& e);
 
+//Read count G1 elements written back to back by write_G1. Runs seen
+//before (e.g. the same commitment in every echo) are not decompressed
+//again; they are kept in sys.
+void read_G1s(const unsigned char *&buf, size_t &len, vector<G1>& elts,
+			  NodeIDSize count, const SystemParam& sys);
+
 void write_Zr(string &body, const Zr& elt);
 
 void read_Zr(const unsigned char *&buf, size_t &len, Zr& elt, const Pairing& e);
@@ -65,7 +91,12 @@ void read_str(const unsigned char *&buf, size_t &len, string &str,
 
 void hash_id(G1& elt, NodeID id, const Pairing& e);
 
+//Hash a message to G1 for the BLS signatures of the client
 void hash_msg(G1& elt, string msg, const Pairing& e);
+
+//Hash signed bytes to G1 for the BLS node signatures
+void hash_signed(G1& elt, const unsigned char *data, size_t len, const Pairing& e,
+				 const string& domain = "DKG node signature");
 #include "polynomial.h"
 
 void read_Poly(const unsigned char *&buf, size_t& len, Polynomial& poly,
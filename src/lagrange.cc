@@ -39,11 +39,7 @@ const vector <Zr> lagrange_coeffs(const vector <Zr> indices, const Zr& alpha)
 
 const G1 lagrange_apply(const vector <Zr> coeffs, const vector <G1> shares)
 {
-  G1 falpha(shares[0],true);
-  for (size_t i = 0; i < coeffs.size(); ++i) {
-	falpha *= shares[i]^coeffs[i]; 
-  }
-  return falpha;
+  return G1::multiexp(shares, coeffs);
 }
 
 
@@ -55,3 +51,56 @@ const Zr lagrange_apply(const vector <Zr> coeffs, const vector <Zr> shares){
   }
   return falpha;	
 }
+
+void LagrangeAtZero::clear()
+{
+  denoms.clear();
+  product = Zr();
+  bitmap.clear();
+}
+
+void LagrangeAtZero::add(NodeID id)
+{
+  Zr x(*e, (long int)id);
+  Zr denom = x;
+  for (map<NodeID, Zr>::iterator it = denoms.begin(); it != denoms.end(); ++it) {
+	Zr xi(*e, (long int)it->first);
+	it->second *= x - xi;
+	denom *= xi - x;
+  }
+  denoms.insert(make_pair(id, denom));
+  product = product.isElementPresent() ? product * x : x;
+  size_t byte = id / 8;
+  if (bitmap.size() <= byte) bitmap.resize(byte + 1, '\0');
+  bitmap[byte] |= 1 << (id % 8);
+}
+
+const vector <Zr> LagrangeAtZero::coeffs()
+{
+  map<string, vector<Zr> >::const_iterator found = cache.find(bitmap);
+  if (found != cache.end()) return found->second;
+
+  //Invert all denominators at once: prefix products, one inversion,
+  //then walk back
+  vector<Zr> d, prefix;
+  for (map<NodeID, Zr>::const_iterator it = denoms.begin(); it != denoms.end(); ++it) {
+	d.push_back(it->second);
+	prefix.push_back(prefix.empty() ? it->second : prefix.back() * it->second);
+  }
+  vector<Zr> lambda(d.size());
+  if (d.empty()) return lambda;
+  Zr inv = prefix.back().inverse();
+  for (size_t i = d.size() - 1; i > 0; --i) {
+	lambda[i] = product * inv * prefix[i-1];
+	inv *= d[i];
+  }
+  lambda[0] = product * inv;
+
+  if (cacheOrder.size() >= LAGRANGE_CACHE_SETS) {
+	cache.erase(cacheOrder.front());
+	cacheOrder.pop();
+  }
+  cache.insert(make_pair(bitmap, lambda));
+  cacheOrder.push(bitmap);
+  return lambda;
+}
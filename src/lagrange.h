@@ -21,7 +21,11 @@
 #define __LAGRANGE_H__
 
 #include "PBC/PBC.h"
+#include "systemparam.h"
 #include <vector>
+#include <map>
+#include <queue>
+#include <string>
 // Compute Lagrange coefficients.
 // indices is an array of element_t of length num, containing the
 //     indices to compute over (members of a Zr ring)
@@ -46,7 +50,37 @@ const vector <Zr> lagrange_coeffs(const vector <Zr> indices, const Zr& alpha);
 //
 
 //const G1 lagrange_apply(size_t num, Zr *coeffs, G1 *shares);
+//For G1 the shares are combined with one multiexp
 const G1 lagrange_apply(const vector <Zr> coeffs, const vector <G1> shares);
 //For Zr
 const Zr lagrange_apply(const vector <Zr> coeffs, const vector <Zr> shares);
+
+//Sets of signers whose coefficients LagrangeAtZero keeps
+#define LAGRANGE_CACHE_SETS 64
+
+// Lagrange coefficients at zero for node IDs that arrive one at a time.
+// lambda_i = prod_{j != i} x_j / (x_j - x_i)
+//          = (prod_j x_j) / (x_i * prod_{j != i} (x_j - x_i))
+// The denominators are updated as each ID is added, so that coeffs() is
+// left with one inversion for all of them. Coefficients are remembered per
+// set of IDs, since the same nodes tend to be the first to answer.
+class LagrangeAtZero {
+public:
+  LagrangeAtZero(): e(NULL) {}
+  LagrangeAtZero(const Pairing &e): e(&e) {}
+  //Start a new set; the remembered coefficients are kept
+  void clear();
+  void add(NodeID id);
+  size_t size() const {return denoms.size();}
+  //Coefficients of the IDs added so far, in increasing order of ID
+  const vector <Zr> coeffs();
+
+private:
+  const Pairing *e;
+  map <NodeID, Zr> denoms;
+  Zr product;
+  string bitmap;
+  map <string, vector <Zr> > cache;
+  queue <string> cacheOrder;
+};
 #endif
@@ -19,6 +19,8 @@
 
 #include "networkmessage.h"
 #include "io.h"
+#include "sigpool.h"
+#include "erasure.h"
 
 NetworkMessage& NetworkMessage::operator=(const NetworkMessage &rhs){
 	if (this == &rhs) return *this; 
@@ -27,10 +29,10 @@ NetworkMessage& NetworkMessage::operator=(const NetworkMessage &rhs){
 	return *this;
 }
 
-// Read the message from the socket associated with the given Buddy
-NetworkMessage *NetworkMessage::read_message(SystemType systemtype, const Buddy *buddy)
+// Take the next message off the input buffer of the given Buddy
+NetworkMessage *NetworkMessage::read_message(SystemType systemtype, Buddy *buddy,
+											 SigJob *job)
 {
-  int msg_type;//Message type of one byte
   string msgStr;
 
   int res = buddy->read_messagestr(msgStr);
@@ -38,12 +40,33 @@ NetworkMessage *NetworkMessage::read_message(SystemType systemtype, const Buddy
 	 // cerr << "Something wrong here" << endl;
 	  return NULL;
   }
-  //msg_type = (int)msgStr[0];
-  msg_type = (int)msgStr[4];
 
   int g_recv_ID = (msgStr[0] << 24) | (((msgStr[1]) << 16) & 0x00ffffff) |
 		  (((msgStr[2]) << 8) & 0x0000ffff) | (msgStr[3] & 0x000000ff);
-  msgStr = msgStr.substr(4);
+  return parse_message(systemtype, buddy, msgStr.substr(4), g_recv_ID, job);
+}
+
+int NetworkMessage::priority(int type)
+{
+  switch (type) {
+  // The agreement, whose timeouts start leader changes
+  case DKG_SEND: case DKG_ECHO: case DKG_READY: case DKG_HELP:
+  case LEADER_CHANGE: case VSS_SHARED:
+	return PRIORITY_AGREEMENT;
+  // The sharings, with commitments of up to megabytes each
+  case VSS_SEND: case VSS_ECHO: case VSS_READY: case VSS_COMMITMENT:
+  case VSS_SEND_FRAGMENT: case VSS_FRAGMENT:
+	return PRIORITY_BULK;
+  default:
+	return PRIORITY_CONTROL;
+  }
+}
+
+NetworkMessage *NetworkMessage::parse_message(SystemType systemtype, const Buddy *buddy,
+											  const string &msgStr, int g_recv_ID,
+											  SigJob *job)
+{
+  int msg_type = (int)msgStr[0];
 
   switch(systemtype){
   case NODE:
@@ -56,20 +79,33 @@ NetworkMessage *NetworkMessage::read_message(SystemType systemtype, const Buddy
 		return new VSSEchoMessage(buddy, msgStr, g_recv_ID);
   	case VSS_READY: 
 		return new VSSReadyMessage(buddy, msgStr, g_recv_ID);
-  	case VSS_SHARED: 
-		return new VSSSharedMessage(buddy, msgStr, g_recv_ID);	
+  	case VSS_SHARED: {
+		VSSSharedMessage *msg = new VSSSharedMessage(buddy, msgStr, g_recv_ID, job);
+		if (job) job->report_to(&msg->msgValid);
+		return msg;}
   	case VSS_HELP:
 		return new VSSHelpMessage(buddy, msgStr, g_recv_ID);
-  	case DKG_SEND: 
-		return new DKGSendMessage(buddy, msgStr, g_recv_ID);
+  	case VSS_COMMITMENT_REQUEST:
+		return new VSSCommitmentRequestMessage(buddy, msgStr, g_recv_ID);
+  	case VSS_COMMITMENT:
+		return new VSSCommitmentMessage(buddy, msgStr, g_recv_ID);
+  	case VSS_SEND_FRAGMENT:
+  	case VSS_FRAGMENT:
+		return new VSSFragmentMessage(buddy, msgStr, g_recv_ID);
+  	case DKG_SEND: {
+		DKGSendMessage *msg = new DKGSendMessage(buddy, msgStr, g_recv_ID, job);
+		if (job) job->report_to(&msg->msgValid);
+		return msg;}
   	case DKG_ECHO: 
 		return new DKGEchoMessage(buddy, msgStr, g_recv_ID);
   	case DKG_READY: 
 		return new DKGReadyMessage(buddy, msgStr, g_recv_ID);
   	case DKG_HELP: 
 		return new DKGHelpMessage(buddy, msgStr, g_recv_ID);
-  	case LEADER_CHANGE:
-		return new LeaderChangeMessage(buddy, msgStr, g_recv_ID);
+  	case LEADER_CHANGE: {
+		LeaderChangeMessage *msg = new LeaderChangeMessage(buddy, msgStr, g_recv_ID, job);
+		if (job) job->report_to(&msg->msgValid);
+		return msg;}
 	case PUBLIC_KEY_EXCHANGE:
 	 	return new PublicKeyExchangeMessage(buddy, msgStr, g_recv_ID);
 	case BLS_SIGNATURE_REQUEST: 	
@@ -144,13 +180,14 @@ VSSSendMessage:: VSSSendMessage(const Buddy *buddy, const string &str, int g_rec
 	msg_ID = g_recv_ID;
 }
 
-VSSEchoMessage:: VSSEchoMessage(NodeID dealer,Phase ph,	const Commitment& C, const Zr& alpha)
+VSSEchoMessage:: VSSEchoMessage(const BuddySet &buddyset, NodeID dealer,Phase ph,
+								const Commitment& C, const Zr& alpha, bool byDigest)
   :dealer(dealer), ph(ph),C(C),alpha(alpha)
 {
   string body;
   write_us(body,dealer);
   write_ui(body, ph);
-  body.append(C.toString());
+  body.append(byDigest ? C.toDigestString(buddyset.get_commitments()) : C.toString());
   write_Zr(body,alpha);
   addMsgHeader(VSS_ECHO, body);
   addMsgID(msg_ID, body);
@@ -163,20 +200,26 @@ VSSEchoMessage::VSSEchoMessage(const Buddy *buddy, const string &str, int g_recv
   size_t bodylen = str.size() - headerLength;
   read_us(bodyptr, bodylen, dealer);
   read_ui(bodyptr, bodylen, ph);
-  C = Commitment(buddy->get_param(), bodyptr, bodylen);
-  read_Zr(bodyptr, bodylen, alpha, buddy->get_param().get_Pairing());
   msg_ID = g_recv_ID;
+  string digest;
+  if (!Commitment::read_digest(bodyptr, bodylen, digest)) {
+	C = Commitment(buddy->get_param(), bodyptr, bodylen);
+  } else if (!buddy->get_buddyset().get_commitments().recall(digest, C)) {
+	missing = digest;
+	return;
+  }
+  read_Zr(bodyptr, bodylen, alpha, buddy->get_param().get_Pairing());
 }
 
 VSSReadyMessage::VSSReadyMessage(const BuddySet &buddyset,NodeID dealer,Phase ph,
-				const Commitment& C, const Zr& alpha, bool includeSignature)
+				const Commitment& C, const Zr& alpha, bool includeSignature, bool byDigest)
 		:dealer(dealer),ph(ph),C(C),alpha(alpha){
 // Zr should be last element of the message and shouldn't be signed
   string body;  
   //size_t signstart = body.size(); 
   write_us(body,dealer);
   write_ui(body, ph);
-  body.append(C.toString());
+  body.append(byDigest ? C.toDigestString(buddyset.get_commitments()) : C.toString());
   //size_t signend = body.size();
   strMsg = toString();
   write_byte(body,includeSignature);  
@@ -200,7 +243,14 @@ VSSReadyMessage::VSSReadyMessage(const Buddy *buddy, const string &str, int g_re
   
   read_us(bodyptr, bodylen, dealer);
   read_ui(bodyptr, bodylen, ph);
-  C = Commitment(buddy->get_param(), bodyptr, bodylen); 
+  string digest;
+  if (!Commitment::read_digest(bodyptr, bodylen, digest)) {
+	C = Commitment(buddy->get_param(), bodyptr, bodylen); 
+  } else if (!buddy->get_buddyset().get_commitments().recall(digest, C)) {
+	missing = digest;
+	msgValid = false;
+	return;
+  }
     
   if(bodylen == 0){
   	//This will happen for object generated from strMsg.
@@ -249,24 +299,110 @@ VSSHelpMessage:: VSSHelpMessage(const Buddy *buddy, const string &str, int g_rec
   msg_ID = g_recv_ID;
 }
 
-VSSSharedMessage::VSSSharedMessage(Phase ph, NodeID dealer,	const VSSReadyMessage& readyMsg, 
-								const map <NodeID, string>& msgDSAs)
+VSSCommitmentRequestMessage::VSSCommitmentRequestMessage(const string &digest)
+	: digest(digest) {
+	string body = digest;
+	addMsgHeader(VSS_COMMITMENT_REQUEST, body); 
+	addMsgID(msg_ID, body);
+	set_netMsgStr(body);
+}
+
+VSSCommitmentRequestMessage::VSSCommitmentRequestMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+  : NetworkMessage(str) {
+  digest = str.substr(headerLength);
+  msg_ID = g_recv_ID;
+}
+
+VSSCommitmentMessage::VSSCommitmentMessage(const Commitment &C)
+	: C(C) {
+	string body = C.toString();
+	addMsgHeader(VSS_COMMITMENT, body); 
+	addMsgID(msg_ID, body);
+	set_netMsgStr(body);
+}
+
+VSSCommitmentMessage::VSSCommitmentMessage(const string &commitmentStr){
+	string body = commitmentStr;
+	addMsgHeader(VSS_COMMITMENT, body); 
+	addMsgID(msg_ID, body);
+	set_netMsgStr(body);
+}
+
+VSSCommitmentMessage::VSSCommitmentMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+  : NetworkMessage(str) {
+  const unsigned char *bodyptr = (const unsigned char *)str.data() + headerLength;
+  size_t bodylen = str.size() - headerLength;
+  C = Commitment(buddy->get_param(), bodyptr, bodylen);
+  msg_ID = g_recv_ID;
+}
+
+VSSFragmentMessage::VSSFragmentMessage(NodeID dealer, Phase ph, const string &root,
+									   unsigned short count, unsigned int length,
+									   unsigned short index, const string &fragment,
+									   const vector<string> &proof, const Polynomial *a)
+	: dealer(dealer), ph(ph), root(root), count(count), length(length), index(index),
+	  fragment(fragment), proof(proof) {
+	string body;
+	write_us(body, dealer);
+	write_ui(body, ph);
+	write_str(body, root, FRAGMENT_HASH_SIZE);
+	write_us(body, count);
+	write_ui(body, length);
+	write_us(body, index);
+	write_ui(body, fragment.length());
+	body.append(fragment);
+	write_byte(body, proof.size());
+	for (vector<string>::const_iterator it = proof.begin(); it != proof.end(); ++it)
+		write_str(body, *it, FRAGMENT_HASH_SIZE);
+	if (a) {
+		this->a = *a;
+		write_Poly(body, *a);
+	}
+	addMsgHeader(a ? VSS_SEND_FRAGMENT : VSS_FRAGMENT, body);
+	addMsgID(msg_ID, body);
+	set_netMsgStr(body);
+}
+
+VSSFragmentMessage::VSSFragmentMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+  : NetworkMessage(str) {
+	const unsigned char *bodyptr = (const unsigned char *)str.data() + headerLength;
+	size_t bodylen = str.size() - headerLength;
+	read_us(bodyptr, bodylen, dealer);
+	read_ui(bodyptr, bodylen, ph);
+	read_str(bodyptr, bodylen, root, FRAGMENT_HASH_SIZE);
+	read_us(bodyptr, bodylen, count);
+	read_ui(bodyptr, bodylen, length);
+	read_us(bodyptr, bodylen, index);
+	unsigned int fraglen;
+	read_ui(bodyptr, bodylen, fraglen);
+	read_str(bodyptr, bodylen, fragment, fraglen);
+	unsigned char depth;
+	read_byte(bodyptr, bodylen, depth);
+	if (depth > FRAGMENT_MAX_PROOF) throw InvalidMessageException();
+	proof.resize(depth);
+	for (unsigned char i = 0; i < depth; ++i)
+		read_str(bodyptr, bodylen, proof[i], FRAGMENT_HASH_SIZE);
+	if (get_message_type() == VSS_SEND_FRAGMENT)
+		read_Poly(bodyptr, bodylen, a, buddy->get_param().get_Pairing());
+	msg_ID = g_recv_ID;
+}
+
+bool VSSFragmentMessage::check() const {
+	return fragment_check(root, count, length, index, fragment, proof);
+}
+
+VSSSharedMessage::VSSSharedMessage(const BuddySet &buddyset, Phase ph, NodeID dealer,
+								const VSSReadyMessage& readyMsg, const map <NodeID, string>& msgDSAs)
 	:ph(ph), dealer(dealer), readyMsg(readyMsg), msgDSAs(msgDSAs){
 	string body;
   	write_ui(body, ph);
   	write_us(body,dealer);
   	write_ui(body,readyMsg.strMsg.length());
   	body.append(readyMsg.strMsg);
-  	write_us(body,(NodeID)msgDSAs.size());
-	map <NodeID, string>::const_iterator iter1d;
-	for(iter1d = msgDSAs.begin(); iter1d != msgDSAs.end(); ++iter1d){
-	  write_us(body,iter1d->first);
-	  //write_ui(body,iter1d->second.strMsg.length());
-	  body.append(iter1d->second);
-	}  	
+  	write_sigs(buddyset.get_param(), body, msgDSAs);
 }
 
-VSSSharedMessage::VSSSharedMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+VSSSharedMessage::VSSSharedMessage(const Buddy *buddy, const string &str, int g_recv_ID, SigJob *job)
     : NetworkMessage(str){
   	const unsigned char *bodyptr = (const unsigned char *)str.data() + headerLength;
 	size_t bodylen = str.size() - headerLength;
@@ -283,15 +419,10 @@ VSSSharedMessage::VSSSharedMessage(const Buddy *buddy, const string &str, int g_
 	const unsigned char *signend = bodyptr;
 		
   	//Deserialize Signature on VSSReadyMessage
-  	unsigned short size; read_us(bodyptr, bodylen, size);
-  	if(size < 2*buddy->get_param().get_t() + 1) {msgValid = false; return;} 
-  	for(unsigned short i = 0; i< size; ++i){
-		NodeID sender; read_us(bodyptr, bodylen, sender);
-		msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);
-		if (!msgValid) return; 		
-		string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());		
-		msgDSAs.insert(pair<NodeID,string>(sender,DSA));		
-  	}
+  	SigJob ownJob;
+  	msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, msgDSAs, job ? job : &ownJob)
+  		&& (job || verify_sigs(ownJob));
+  	if(msgDSAs.size() < 2*buddy->get_param().get_t() + 1u) msgValid = false;
 }
 /*
 DKGSendMessage::DKGSendMessage(Phase ph, const map <VSSReadyMessage, map <NodeID, string>, 
@@ -318,12 +449,11 @@ DKGSendMessage::DKGSendMessage(Phase ph, const map <VSSReadyMessage, map <NodeID
   	addMsgHeader(DKG_SEND, body); set_netMsgStr(body);
 }
 */
-DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,const map<NodeID, string>& leadChgMsgDSAs,
-							const map <VSSReadyMessage, map <NodeID, string>, VSSReadyMessageCmp >& vssReadyMsg)
+DKGSendMessage::DKGSendMessage(const BuddySet &buddyset, Phase ph, const LeaderChangeMessage& leadChgMsg,
+							const map<NodeID, string>& leadChgMsgDSAs, const map <VSSReadyMessage, map <NodeID, string>, VSSReadyMessageCmp >& vssReadyMsg)
   	:ph(ph), leadChgMsg(leadChgMsg),leadChgMsgDSAs(leadChgMsgDSAs), msgType(VSS_READY), vssReadyMsg(vssReadyMsg){
   	string body;
   	bool isLeaderChangePresent = true;
-  	map <NodeID, string>::const_iterator iter1d;
   	write_ui(body, ph);
  	write_byte(body,isLeaderChangePresent);
  	
@@ -333,11 +463,7 @@ DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,c
   	//for(iter2dLead = leadChgMsg.begin(); iter2dLead != leadChgMsg.end(); ++iter2dLead){
 	write_ui(body,leadChgMsg.strMsg.length());
 	body.append(leadChgMsg.strMsg);
-	write_us(body,(NodeIDSize)leadChgMsgDSAs.size());
-	for(iter1d = leadChgMsgDSAs.begin(); iter1d != leadChgMsgDSAs.end(); ++iter1d){
-		write_us(body,iter1d->first);		
-		body.append(iter1d->second);	
-	}
+	write_sigs(buddyset.get_param(), body, leadChgMsgDSAs);
 	write_byte(body,msgType);
 	
   	//Serialize VSSReady Messages
@@ -346,24 +472,19 @@ DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,c
   	for(iter2dMsg = vssReadyMsg.begin(); iter2dMsg != vssReadyMsg.end(); ++iter2dMsg){
 		write_ui(body,iter2dMsg->first.strMsg.length());
 		body.append(iter2dMsg->first.strMsg);
-		write_us(body,(NodeID)iter2dMsg->second.size());
-		for(iter1d = iter2dMsg->second.begin(); iter1d != iter2dMsg->second.end();++iter1d){
-	  		write_us(body,iter1d->first);
-	  		body.append(iter1d->second);
-		}
+		write_sigs(buddyset.get_param(), body, iter2dMsg->second);
   	}
   	addMsgHeader(DKG_SEND, body);
   	addMsgID(msg_ID, body);
   	set_netMsgStr(body);
 }
 
-DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,const map<NodeID, string>& leadChgMsgDSAs,
-				 NetworkMessageType msgType, const DKGEchoOrReadyMessage& dkgEchoOrReadyMsg,const map <NodeID, string>& dkgEchoOrReadyMsgDSAs)	
+DKGSendMessage::DKGSendMessage(const BuddySet &buddyset, Phase ph, const LeaderChangeMessage& leadChgMsg,
+				 const map<NodeID, string>& leadChgMsgDSAs, NetworkMessageType msgType, const DKGEchoOrReadyMessage& dkgEchoOrReadyMsg,const map <NodeID, string>& dkgEchoOrReadyMsgDSAs)	
   	:ph(ph),leadChgMsg(leadChgMsg),leadChgMsgDSAs(leadChgMsgDSAs),msgType(msgType),dkgEchoOrReadyMsg(dkgEchoOrReadyMsg),
   	dkgEchoOrReadyMsgDSAs(dkgEchoOrReadyMsgDSAs){
   	string body;
   	bool isLeaderChangePresent = true;
-  	map <NodeID, string>::const_iterator iter1d;
   	write_ui(body, ph);
   	write_byte(body,isLeaderChangePresent);
  	
@@ -374,11 +495,7 @@ DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,c
   	//for(iter2dLead = leadChgMsg.begin(); iter2dLead != leadChgMsg.end(); ++iter2dLead){
 	write_ui(body,leadChgMsg.strMsg.length());
 	body.append(leadChgMsg.strMsg);
-	write_us(body,(NodeIDSize)leadChgMsgDSAs.size());
-	for(iter1d = leadChgMsgDSAs.begin(); iter1d != leadChgMsgDSAs.end(); ++iter1d){
-		write_us(body,iter1d->first);		
-		body.append(iter1d->second);	
-	}
+	write_sigs(buddyset.get_param(), body, leadChgMsgDSAs);
 	
 	write_byte(body,msgType);	
   	//Serialize DKGEchoOrReady Message
@@ -387,18 +504,14 @@ DKGSendMessage::DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg,c
   	//for(iter2dMsg = dkgEchoOrReadyMsg.begin(); iter2dMsg != dkgEchoOrReadyMsg.end(); ++iter2dMsg){
 	write_ui(body,dkgEchoOrReadyMsg.strMsg.length());
 	body.append(dkgEchoOrReadyMsg.strMsg);
-	write_us(body,dkgEchoOrReadyMsgDSAs.size());
-	for(iter1d = dkgEchoOrReadyMsgDSAs.begin(); iter1d != dkgEchoOrReadyMsgDSAs.end();++iter1d){
-  		write_us(body,iter1d->first);
-  		body.append(iter1d->second);
-	} 	
+	write_sigs(buddyset.get_param(), body, dkgEchoOrReadyMsgDSAs);
   	addMsgHeader(DKG_SEND, body);
   	addMsgID(msg_ID, body);
   	set_netMsgStr(body);
 }
 
 
-DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv_ID, SigJob *job)
   : NetworkMessage(str) {
   	NodeIDSize t = buddy->get_param().get_t();
 	const unsigned char *bodyptr = (const unsigned char *)str.data() + headerLength;
@@ -408,23 +521,21 @@ DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv
 	
 	unsigned char charLeaderChangePresent; read_byte(bodyptr, bodylen, charLeaderChangePresent);
 	bool isLeaderChangePresent = (bool)charLeaderChangePresent;
+	//The embedded signatures are left to the caller's job, or checked
+	//together at the end
+	SigJob ownJob;
+	SigJob *sigs = job ? job : &ownJob;
 	
 	if (isLeaderChangePresent){
 	//Deserialize LeaderChange Messages
 		unsigned length = 0; read_ui(bodyptr,bodylen,length);
 		const unsigned char *signstart = bodyptr;
-		leadChgMsg = LeaderChangeMessage(buddy, str.substr(str.length() - bodylen, length)); 
+		leadChgMsg = LeaderChangeMessage(buddy, str.substr(str.length() - bodylen, length), 0, sigs); 
 		bodylen-= length; bodyptr+= length;
 		const unsigned char *signend = bodyptr;	
-		NodeIDSize size1d; read_us(bodyptr, bodylen, size1d);
-		if(size1d < 2*t + 1) {cerr<<"Not enough lc signs\n"; msgValid = false; return;}	
-		for(NodeIDSize j = 0; j< size1d; ++j){
-			NodeID sender; read_us(bodyptr, bodylen, sender);
-			msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);	
-			if (!msgValid) {cerr<<"Invalid lc Signature from sender "<<sender<<" "<<buddy->find_other_buddy(sender)->get_id()<<endl;return;}//Invalid Signature Signature
-			string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-			leadChgMsgDSAs.insert(make_pair(sender,DSA));  		
-		}
+		msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, leadChgMsgDSAs, sigs);
+		if (!msgValid) {cerr<<"Invalid lc Signature\n";return;}//Invalid Signature Signature
+		if(leadChgMsgDSAs.size() < 2*t + 1u) {cerr<<"Not enough lc signs\n"; msgValid = false; return;}	
 	}
 	//Deserialize SignedMessage
 	unsigned short size2d;
@@ -442,16 +553,10 @@ DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv
 			VSSReadyMessage msg(buddy,strMsg);
 			bodylen-= length; bodyptr+= length;
 			const unsigned char *signend = bodyptr;
-  			unsigned short size1d; read_us(bodyptr, bodylen, size1d);
-			if(size1d < 2*t + 1) {cerr<<"Not enough VSS signs\n";msgValid = false; return;}
 		  	map <NodeID, string> DSAMap;
-  			for(unsigned short j = 0; j< size1d; ++j){
-  				NodeID sender; read_us(bodyptr, bodylen, sender);
-  				msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);
-  				if (!msgValid) {cerr<<"Invalid vss Signature for j="<<j<<endl;return;}//Invalid Signature Signature
-  				string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-  				DSAMap.insert(make_pair(sender,DSA));
-  			}
+  			msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, DSAMap, sigs);
+  			if (!msgValid) {cerr<<"Invalid vss Signature for i="<<i<<endl;return;}//Invalid Signature Signature
+			if(DSAMap.size() < 2*t + 1u) {cerr<<"Not enough VSS signs\n";msgValid = false; return;}
   			vssReadyMsg.insert(make_pair(msg,DSAMap));
   		}
 	}break;
@@ -462,15 +567,9 @@ DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv
 		dkgEchoOrReadyMsg = DKGEchoMessage(buddy,strMsg);
 		bodylen-= length; bodyptr+= length;
 		const unsigned char *signend = bodyptr;
-  		unsigned short size1d; read_us(bodyptr, bodylen, size1d);
-		if(size1d < 2*t + 1) {cerr<<"Not enough DKGEcho signs\n"; msgValid = false; return;}		
-  		for(unsigned short j = 0; j< size1d; ++j){
-  			NodeID sender; read_us(bodyptr, bodylen, sender);
-  			msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);
-  			if (!msgValid) return;//Invalid Signature Signature
-  			string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-  			dkgEchoOrReadyMsgDSAs.insert(make_pair(sender,DSA));
-  		}
+  		msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, dkgEchoOrReadyMsgDSAs, sigs);
+  		if (!msgValid) return;//Invalid Signature Signature
+		if(dkgEchoOrReadyMsgDSAs.size() < 2*t + 1u) {cerr<<"Not enough DKGEcho signs\n"; msgValid = false; return;}		
 	}break;
 	case DKG_READY:{
 		unsigned int length; read_ui(bodyptr,bodylen,length);
@@ -479,18 +578,13 @@ DKGSendMessage::DKGSendMessage(const Buddy *buddy, const string &str, int g_recv
 		dkgEchoOrReadyMsg = DKGReadyMessage(buddy,strMsg);
 		bodylen-= length; bodyptr+= length;
 		const unsigned char *signend = bodyptr;
-  		unsigned short size1d; read_us(bodyptr, bodylen, size1d);
-		if(size1d < t + 1) {cerr<<"Not enough DKGReady signs\n"; msgValid = false; return;}		
-  		for(unsigned short j = 0; j< size1d; ++j){
-  			NodeID sender; read_us(bodyptr, bodylen, sender);
-  			msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);
-  			if (!msgValid) return;//Invalid Signature Signature
-  			string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-  			dkgEchoOrReadyMsgDSAs.insert(make_pair(sender,DSA));
-  		}
+  		msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, dkgEchoOrReadyMsgDSAs, sigs);
+  		if (!msgValid) return;//Invalid Signature Signature
+		if(dkgEchoOrReadyMsgDSAs.size() < t + 1u) {cerr<<"Not enough DKGReady signs\n"; msgValid = false; return;}		
 	}break;	
   	default:{cerr<<"Wrong message type\n"; msgValid = false; return;}
 	}
+	if (!job && !verify_sigs(ownJob)) {cerr<<"Invalid Signature in DKGSend\n"; msgValid = false;}
 }
 
 DKGEchoOrReadyMessage::DKGEchoOrReadyMessage(const BuddySet &buddyset,NetworkMessageType type,NodeID leader,Phase ph,
@@ -587,7 +681,6 @@ DKGHelpMessage(const Buddy *buddy, const string &str, int g_recv_ID)
 		const map <VSSReadyMessage, map <NodeID, string> , VSSReadyMessageCmp> &vssReadyMsg, bool includeSignature)
 	:ph(ph), nextLeader(nextLeader),msgType(VSS_READY),vssReadyMsg(vssReadyMsg){
 	string body;
-	map <NodeID, string>::const_iterator iter1d;
 	write_ui(body, ph);
 	write_us(body,nextLeader);
 	write_byte(body,msgType);
@@ -598,11 +691,7 @@ DKGHelpMessage(const Buddy *buddy, const string &str, int g_recv_ID)
   	for(iter2dMsg = vssReadyMsg.begin(); iter2dMsg != vssReadyMsg.end(); ++iter2dMsg){
 		write_ui(body,iter2dMsg->first.strMsg.length());
 		body.append(iter2dMsg->first.strMsg);
-		write_us(body,(NodeID)iter2dMsg->second.size());
-		for(iter1d = iter2dMsg->second.begin(); iter1d != iter2dMsg->second.end();++iter1d){
-	  		write_us(body,iter1d->first);
-	  		body.append(iter1d->second);
-		}
+		write_sigs(buddyset.get_param(), body, iter2dMsg->second);
   	}	
 	strMsg = toString();
 	write_byte(body,includeSignature);
@@ -628,12 +717,7 @@ LeaderChangeMessage::LeaderChangeMessage(const BuddySet &buddyset, Phase ph,Node
   write_ui(body,dkgEchoOrReadyMsg.strMsg.length());
   body.append(dkgEchoOrReadyMsg.strMsg);
 
-  map <NodeID, string>::const_iterator iter;
-  write_us(body,(NodeID)DSAs.size());  
-  for(iter = DSAs.begin(); iter != DSAs.end(); ++iter){   
-	  write_us(body,iter->first);
-	  body.append(iter->second);
-  }
+  write_sigs(buddyset.get_param(), body, DSAs);
   //size_t signend = body.size();
   strMsg = toString();
   write_byte(body,includeSignature);
@@ -670,7 +754,7 @@ LeaderChangeMessage::LeaderChangeMessage(const BuddySet &buddyset,/* Phase ph,*/
 }
 
 
-LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str, int g_recv_ID)
+LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str, int g_recv_ID, SigJob *job)
   :NetworkMessage(str){
 	NodeIDSize t = buddy->get_param().get_t();
   const unsigned char *bodyptr = (const unsigned char *)str.data() + headerLength;
@@ -687,6 +771,8 @@ LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str,
   
   unsigned char typeChar; read_byte(bodyptr,bodylen,typeChar);
   msgType = (NetworkMessageType) typeChar;
+  SigJob ownJob;
+  SigJob *sigs = job ? job : &ownJob;
   
 	if (msgType == VSS_READY){
 		NodeID size2d;
@@ -699,16 +785,10 @@ LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str,
 			VSSReadyMessage msg(buddy,strMsg);
 			bodylen-= length; bodyptr+= length;
 			const unsigned char *signend = bodyptr;
-  			unsigned short size1d; read_us(bodyptr, bodylen, size1d);
-			if(size1d < 2*t + 1) {msgValid = false; return;}
 		  	map <NodeID, string> DSAMap;
-  			for(unsigned short j = 0; j< size1d; ++j){
-  				NodeID sender; read_us(bodyptr, bodylen, sender);
-  				msgValid = read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen, signstart, signend);
-  				if (!msgValid) return;//Invalid Signature Signature
-  				string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-  				DSAMap.insert(make_pair(sender,DSA));
-  			}
+  			msgValid = read_sigs(buddy, bodyptr, bodylen, signstart, signend, DSAMap, sigs);
+  			if (!msgValid) return;//Invalid Signature Signature
+			if(DSAMap.size() < 2*t + 1u) {msgValid = false; return;}
   			vssReadyMsg.insert(make_pair(msg,DSAMap));
   		}
 	} else if ((msgType == DKG_ECHO)||(msgType == DKG_READY)){
@@ -718,22 +798,16 @@ LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str,
 	  bodylen -= length; bodyptr += length;
 	
 	  //Deserialize Signature on VSSReadyMessage
-	  NodeID size;
 	  const unsigned char *start = (const unsigned char *)dkgEchoOrReadyMsg.strMsg.data();
 	  const unsigned char *end = (const unsigned char *)dkgEchoOrReadyMsg.strMsg.data() 
 	  								+ dkgEchoOrReadyMsg.strMsg.length();
-	  read_us(bodyptr, bodylen, size);
+	  if (!read_sigs(buddy, bodyptr, bodylen, start, end, dkgEchoOrReadyMsgDSAs, sigs)){
+		msgValid = false; return;}
+	  NodeID size = dkgEchoOrReadyMsgDSAs.size();
 	  switch (dkgEchoOrReadyMsg.strMsg[0]){
 	  	case DKG_ECHO:if(size < 2*t + 1) {msgValid = false; return;}
 	  	case DKG_READY:if(size < t + 1) {msgValid = false; return;}
 	  }
-	  for(NodeID i = 0; i< size; ++i){
-		NodeID sender; read_us(bodyptr, bodylen, sender);
-		if (!read_sig(buddy->find_other_buddy(sender), bodyptr, bodylen,start,end)){
-			msgValid = false; return;}
-		string DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
-		dkgEchoOrReadyMsgDSAs.insert(pair<NodeID,string>(sender,DSA));
-	  }
 	} else if (msgType == NET_MSG_NONE){
 		if (ph) {msgValid = false;return;}
 	} else {msgValid = false; return;}
@@ -744,6 +818,7 @@ LeaderChangeMessage::LeaderChangeMessage(const Buddy *buddy, const string &str,
 			(const unsigned char *)strMsg.data() + strMsg.length());			
 		DSA = str.substr(str.size()-bodylen- buddy->sig_size(), buddy->sig_size());
 	} else msgValid = true; 	
+	if (msgValid && !job) msgValid = verify_sigs(ownJob);
 }
 
 string LeaderChangeMessage::toString() const{
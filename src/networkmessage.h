@@ -31,7 +31,8 @@ typedef enum {
   VSS_SEND, VSS_ECHO, VSS_READY, VSS_SHARED, VSS_HELP,
   DKG_SEND, DKG_ECHO, DKG_READY, DKG_HELP, LEADER_CHANGE, 
   RECONSTRUCT_SHARE, PUBLIC_KEY_EXCHANGE, BLS_SIGNATURE_REQUEST, 
-  BLS_SIGNATURE_RESPONSE, WRONG_BLS_SIGNATURES, VERIFIED_BLS_SIGNATURES
+  BLS_SIGNATURE_RESPONSE, WRONG_BLS_SIGNATURES, VERIFIED_BLS_SIGNATURES,
+  VSS_COMMITMENT_REQUEST, VSS_COMMITMENT, VSS_SEND_FRAGMENT, VSS_FRAGMENT
     } NetworkMessageType;
 
 
@@ -42,7 +43,17 @@ class NetworkMessage: public Message {
 	
 	NetworkMessage(const NetworkMessage& msg): netMsgStr(msg.get_netMsgStr()){message_class = NETWORK;}
 	
-	static NetworkMessage* read_message(SystemType systemtype, const Buddy *buddy);
+	//With a job, the signatures embedded in VSS_SHARED, DKG_SEND and
+	//LEADER_CHANGE messages are left in it for the caller to check
+	static NetworkMessage* read_message(SystemType systemtype, Buddy *buddy,
+										class SigJob *job = NULL);
+	//Build a message from msgStr (the ID taken off) that came from buddy
+	static NetworkMessage* parse_message(SystemType systemtype, const Buddy *buddy,
+										 const string &msgStr, int g_recv_ID,
+										 class SigJob *job = NULL);
+
+	//The class (sendring.h) a message of this type is sent and handled in
+	static int priority(int type);
 
 	//const string& getNetMsgStr() const {return netMsgStr;}
 	NetworkMessageType get_message_type() const {
@@ -101,13 +112,17 @@ public:
 class VSSEchoMessage : public NetworkMessage
 {
 public:
-  VSSEchoMessage(NodeID dealer, Phase ph, const Commitment& commitment, const Zr& alpha);
+  //byDigest sends a matrix commitment as its digest
+  VSSEchoMessage(const BuddySet& buddyset, NodeID dealer, Phase ph,
+				 const Commitment& commitment, const Zr& alpha, bool byDigest = false);
   VSSEchoMessage(const Buddy *buddy, const string &str, int g_recv_ID);
 
   NodeID dealer;
   Phase ph;
   Commitment C;
   Zr alpha;
+  //The digest of a commitment we do not know yet; nothing after it is read
+  string missing;
 };
 
 class VSSReadyMessage : public NetworkMessage
@@ -116,7 +131,7 @@ public:
   VSSReadyMessage(){}
   VSSReadyMessage(const BuddySet& buddyset, NodeID dealer, Phase ph,
 				  const Commitment& commitment, const Zr& alpha, 
-				  bool includeSignature = true);
+				  bool includeSignature = true, bool byDigest = false);
   VSSReadyMessage(const Buddy *buddy, const string &str, int g_recv_ID = 0);
 
   string toString() const;
@@ -128,6 +143,9 @@ public:
   string DSA;
   bool msgValid;
   string strMsg;
+  //As in VSSEchoMessage. strMsg, which is signed, always holds the whole
+  //commitment.
+  string missing;
 };
 
 struct VSSReadyMessageCmp {
@@ -145,9 +163,9 @@ struct VSSReadyMessageCmp {
 class VSSSharedMessage : public NetworkMessage 
 {
 public:
-VSSSharedMessage(Phase ph, NodeID dealer,
+VSSSharedMessage(const BuddySet &buddyset, Phase ph, NodeID dealer,
 				 const VSSReadyMessage &readyMsg, const map <NodeID, string> &msgDSAs);
-VSSSharedMessage(const Buddy *buddy, const string &str, int g_recv_ID);
+VSSSharedMessage(const Buddy *buddy, const string &str, int g_recv_ID, class SigJob *job = NULL);
 
 //VSSSharedMessage(const VSSSharedMessage& msg);
 
@@ -167,6 +185,53 @@ public:
   Phase ph; 
 };
 
+//Asks for the commitment behind a digest we were sent
+class VSSCommitmentRequestMessage : public NetworkMessage
+{
+public:
+  VSSCommitmentRequestMessage(const string &digest);
+  VSSCommitmentRequestMessage(const Buddy *buddy, const string &str, int g_recv_ID);
+
+  string digest;
+};
+
+class VSSCommitmentMessage : public NetworkMessage
+{
+public:
+  VSSCommitmentMessage(const Commitment &commitment);
+  //From the commitment's toString(), as a CommitmentStore keeps it; C is
+  //left empty
+  VSSCommitmentMessage(const string &commitmentStr);
+  VSSCommitmentMessage(const Buddy *buddy, const string &str, int g_recv_ID);
+
+  Commitment C;
+};
+
+//One erasure coded fragment of a dealer's commitment. The dealer's
+//VSS_SEND_FRAGMENT carries the recipient's polynomial as well; the
+//VSS_FRAGMENT with which the recipient passes its fragment on does not.
+class VSSFragmentMessage : public NetworkMessage
+{
+public:
+  VSSFragmentMessage(NodeID dealer, Phase ph, const string &root, unsigned short count,
+					 unsigned int length, unsigned short index, const string &fragment,
+					 const vector<string> &proof, const Polynomial *a = NULL);
+  VSSFragmentMessage(const Buddy *buddy, const string &str, int g_recv_ID);
+
+  //Whether the fragment is the one at index under root
+  bool check() const;
+
+  NodeID dealer;
+  Phase ph;
+  string root;
+  unsigned short count;//Number of fragments
+  unsigned int length;//of the serialized commitment
+  unsigned short index;
+  string fragment;
+  vector<string> proof;
+  Polynomial a;
+};
+
 class ReconstructShareMessage : public NetworkMessage
 {
 public:
@@ -227,7 +292,7 @@ public:
   					const map <NodeID, string>& dkgEchoOrReadyMsgDSAs, bool includeSignature = true);
   LeaderChangeMessage(const BuddySet &buddyset, /*Phase ph,*/ NodeID nextLeader, bool includeSignature = true);
   					 					
-  LeaderChangeMessage(const Buddy *buddy, const string &str, int g_recv_ID = 0);
+  LeaderChangeMessage(const Buddy *buddy, const string &str, int g_recv_ID = 0, class SigJob *job = NULL);
   string toString() const;
   
   
@@ -258,12 +323,12 @@ class DKGSendMessage : public NetworkMessage
 {
 public:
   //DKGSendMessage(Phase ph, const map <VSSReadyMessage, map <NodeID, string>, VSSReadyMessageCmp>& vssReadyMsg);	
-  DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg, const map<NodeID, string>& leadChgMsgDSAs,
+  DKGSendMessage(const BuddySet &buddyset, Phase ph, const LeaderChangeMessage& leadChgMsg, const map<NodeID, string>& leadChgMsgDSAs,
 				 const map <VSSReadyMessage, map <NodeID, string>, VSSReadyMessageCmp>& vssReadyMsg);				 
-  DKGSendMessage(Phase ph, const LeaderChangeMessage& leadChgMsg, const map<NodeID, string> &leadChgMsgDSAs,
+  DKGSendMessage(const BuddySet &buddyset, Phase ph, const LeaderChangeMessage& leadChgMsg, const map<NodeID, string> &leadChgMsgDSAs,
 				 NetworkMessageType msgType, const DKGEchoOrReadyMessage &dkgEchoOrReadyMsg,
 				 const map <NodeID, string> &dkgEchoOrReadyMsgDSAs);
-  DKGSendMessage(const Buddy *buddy, const string &str, int g_recv_ID);
+  DKGSendMessage(const Buddy *buddy, const string &str, int g_recv_ID, class SigJob *job = NULL);
 
   Phase ph;
   LeaderChangeMessage leadChgMsg;
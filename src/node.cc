@@ -22,11 +22,16 @@
 #include "networkmessage.h"
 #include "timer.h"
 #include "exceptions.h"
+#include "erasure.h"
+#include "simbus.h"
 #include <cmath>
 #include <algorithm>
 #include <iomanip>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <fstream>
+#include <deque>
+#include <pthread.h>
 
 typedef enum {LEADER_UNCONFIRMED, UNDER_RECOVERY, FUNCTIONAL, AGREEMENT_STARTED, AGREEMENT_COMPLETED, LEADER_CHANGE_STARTED, DKG_COMPLETED} NodeState;
 
@@ -37,11 +42,55 @@ struct commitmentandshare{
 
 typedef struct commitmentandshare CommitmentAndShare;
 
+//A dealing computed ahead of time: commitment plus every recipient's polynomial
+struct dealing{
+	vector <NodeID> activeNodes;
+	CommitmentType commType;
+	Commitment C;
+	vector <Polynomial> polys;
+};
+
+typedef struct dealing Dealing;
+
+//Dealings kept ready by the dealer thread, for the startup sharing and SHARE
+#define DEALING_POOL_SIZE 2
+
+//An echo or ready that named a commitment we do not have yet
+struct parkedMsg{
+	NodeID from;
+	NodeID dealer;
+	int ID;
+	string str;
+};
+
+//Parked echoes and readies are bounded by what honest nodes send: one of
+//each per sender and commitment, and one of each per sender and dealer
+#define PARKED_PER_SENDER_AND_DIGEST 2
+
+typedef struct parkedMsg ParkedMsg;
+
+//A dealer's commitment being put together from its erasure coded fragments
+struct fragmentSet{
+	fragmentSet():assembled(false),valid(false){}
+	map <unsigned int, string> pieces;
+	bool assembled;
+	bool valid;//Whether the fragments gave a commitment
+	Commitment C;
+};
+
+typedef struct fragmentSet FragmentSet;
+
 class Node : public Application {
 public:
   Node(const char *pairingfile, const char *sysparamfile, in_addr_t listen_addr, in_port_t listen_port,
-  	   const char *certfile, const char *keyfile, const char *contactlistfile, Phase ph, CommitmentType commType =  Feldman_Matrix, int nrln = 0):
-	Application(NODE, pairingfile, sysparamfile, listen_addr, listen_port, certfile, keyfile, contactlistfile, ph),msgLog("message.log",ios::out), timeoutLog("timeout.log",ios::out){
+  	   const char *certfile, const char *keyfile, const char *contactlistfile, Phase ph, CommitmentType commType =  Feldman_Matrix, int nrln = 0,
+  	   bool verifyAtThreshold = false):
+	Application(NODE, pairingfile, sysparamfile, listen_addr, listen_port, certfile, keyfile, contactlistfile, ph){
+	// Simulated nodes (port 0) share a process, and keep no logs
+	if (listen_port != 0) {
+		msgLog.open("message.log", ios::out);
+		timeoutLog.open("timeout.log", ios::out);
+	}
 //  		 Application(NODE, pairingfile, sysparamfile, listen_addr, listen_port, certfile, keyfile, contactlistfile, ph){
 
 	selfID  = NodeID(buddyset.get_my_id());
@@ -52,19 +101,35 @@ public:
 	nodeState = (ph == 0)?FUNCTIONAL:UNDER_RECOVERY; if (selfID == buddyset.get_leader()) nodeState = LEADER_UNCONFIRMED;
 	
 	this->commType = commType;
+	this->verifyAtThreshold = verifyAtThreshold;
 	result.C = Commitment(sysparams, activeNodes, commType);
 	result.share = Zr(sysparams.get_Pairing(),(long int) 0);
 	nextSmallestLeader = buddyset.get_previous_leader();
 	validLeaderChangeMsgCnt = 0;
 	leaderChangeTimerID=0;
+
+	//Dealings are made on a thread of their own, so that they do not hold
+	//up messages. Simulated nodes make them inline, to be charged for them.
+	pthread_mutex_init(&dealerMutex, NULL);
+	pthread_cond_init(&dealerCond, NULL);
+	dealerRunning = dealerBusy = dealerStopping = false;
+	if (listen_port != 0) {
+		dealerRunning = true;
+		pthread_create(&dealerThread, NULL, launch_dealer, this);
+	}
 }
+  ~Node();
   int run();
+  void start();
+  void handle(Message *m, NodeID buddyID);
+  bool finished() const { return nodeState == DKG_COMPLETED; }
   
 private:
 	NodeID selfID;
 	NodeState nodeState;
 	set <NodeID> SendReceived;//This keeps track whether send message is received from a node
 	CommitmentType commType;
+	bool verifyAtThreshold;//Check echo/ready points once at the threshold instead of one by one
 	multimap <NodeID, Commitment> C; //Commitments received
 	map <NodeID, CommitmentAndShare> C_final; //DealerIDs and commitment+shares completed
 	set <NodeID> DecidedVSSs;//DealerIDs for the dealer set (size = t+1) finalized for the node  
@@ -96,14 +161,47 @@ private:
 	int non_responsive_leader_number;
 	int incremental_change;
 	
+	//Made by the dealer thread for activeNodes and commType, which it only
+	//reads; guarded by dealerMutex. dealerBusy is set while it makes one.
+	deque <Dealing> dealingPool;
+	pthread_t dealerThread;
+	pthread_mutex_t dealerMutex;
+	pthread_cond_t dealerCond;
+	bool dealerRunning, dealerBusy, dealerStopping;
+	
+	//Echoes and readies by commitment digest, and whom we asked for it
+	map <string, vector <ParkedMsg> > waitingForC;
+	map <string, set <NodeID> > askedForC;
+	map <string, set <NodeID> > answeredC;//Whom we sent a commitment, by digest
+	map <NodeID, size_t> parkedFrom;//Number of parked messages by sender
+
+	//Commitment fragments by root, whose fragment of each dealer's commitment
+	//we took, and our polynomial from each dealer with the root it came with
+	map <string, FragmentSet> fragmentSets;
+	map <NodeID, set <NodeID> > fragmentSenders;
+	map <NodeID, pair <string, Polynomial> > fragmentPolys;
+	
 	void hybridVSSInit(const Zr& secret);// Share the secret using HybridVSS
+	void hybridVSSInit();// Share a random secret, using a precomputed dealing if there is one
+	void sendDealing(const Dealing& dealing);
+	const Dealing makeDealing(const Zr& secret) const;
+	static void *launch_dealer(void *arg);
+	void dealer();
 	void startAgreement(); // Start DKG as t+1 VSSs have completed
 	void completeDKG(); //(Try to) complete DKG of the DecidedVSSs set
 	void sendLeaderChangeMessage(NodeID nextLeader);
 	void changePhase();
+	void waitForCommitment(NodeID from, NodeID dealer, const NetworkMessage& nm,
+						   const string& digest);
+	bool sharingOpen(NodeID dealer) const;
+	void dropParked(bool all, NodeID dealer = 0);
+	void commitmentArrived(const Commitment& commitment);
+	bool checkFragment(NodeID from, const VSSFragmentMessage& fragment) const;
+	void assembleCommitment(NodeID dealer, const string& root, unsigned int length);
+	void sendFromFragments(NodeID dealer);
 };
 
-int Node::run()
+void Node::start()
 {	
   /*cerr<<"Node "<<selfID<< " is ";
   switch(nodeState){
@@ -173,9 +271,8 @@ int Node::run()
 		if(selfID <= 2*sysparams.get_t()+1){
 		//	if (selfID != buddyset.get_leader())
 				//sleep(10);
-			Zr secret(sysparams.get_Pairing(), true);//Start sharing
-			//Initialize a HybribVSS with the above generated secret
-			hybridVSSInit(secret);
+			//Start sharing a random secret
+			hybridVSSInit();
 		}			
 		gettimeofday (&now, NULL);
 		if (selfID == buddyset.get_leader()) {
@@ -195,17 +292,31 @@ int Node::run()
 		}
 	}
    
+}
+
+int Node::run()
+{
+  start();
   int first_time = 1;
   //sleep (60);
   while(1) {
   	NodeID buddyID = 0;//0 for timer and user messages
 	if (first_time == 1 && selfID == buddyset.get_leader()) {
+		timeval now;
 		gettimeofday (&now, NULL);
 		msgLog << "* I started to receive at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << endl;
 		first_time = 0;
 	}
 	// cout << "ready for next message" << endl;
   	Message *m = get_next_message(buddyID, selfID);
+	handle(m, buddyID);
+  }//Check with Ian about the return value
+  return 1;
+}
+
+void Node::handle(Message *m, NodeID buddyID)
+{
+  timeval now;
 	gettimeofday(&now, NULL);
 	// cout << "next message" << endl;
   switch(m->get_class()) {
@@ -225,9 +336,8 @@ int Node::run()
 		  cerr<<"Phase is greater than 0. Node cannot share a new value"<<endl;
 		  break;
 		}
-		Zr secret(sysparams.get_Pairing(), true);
-		//Initialize a HybribVSS with the above generated secret
-		hybridVSSInit(secret);
+		//Initialize a HybribVSS with a random secret
+		hybridVSSInit();
 	  }break;
 
 	 case CONFIRM_LEADER:{
@@ -336,6 +446,9 @@ int Node::run()
 				//condition below make sure that if the DKG is complete, then VSS only for NodeID the decided set continue
 				((nodeState != AGREEMENT_COMPLETED)||(find(DecidedVSSs.begin(), DecidedVSSs.end(),buddyID) != DecidedVSSs.end()))) {
 				//Send message from the same phase
+				//Echoes and readies may have named it by digest already
+				if (sysparams.use_commitment_digests() && vssSend->C.get_Type() == Feldman_Matrix)
+					commitmentArrived(vssSend->C);
 				if(vssSend->C.verifyPoly(sysparams,selfID,vssSend->a)){							
 					//multimap<NodeID, Commitment>::iterator> ret;
 					//bool commitmentAlreadyExists = false;
@@ -355,12 +468,29 @@ int Node::run()
 						// Note that Echos are not sent twice for a buddy
 
 						vector<NodeID>::iterator iter;//For the active nodes list
-						for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
+						if (vssSend->C.get_Type() == Feldman_Matrix && activeNodes.size()){
+							//Only alpha differs between the echoes, so the
+							//commitment is serialized once for all of them
+							vector<string> alphas;
+							for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
+  								Zr nodeZr = Zr(sysparams.get_Pairing(),(long int)*iter);
+								alphas.push_back(string());
+								write_Zr(alphas.back(), (vssSend->a)(nodeZr));
+							}
+							Zr firstZr = Zr(sysparams.get_Pairing(),(long int)activeNodes.front());
+							VSSEchoMessage vssEcho(buddyset, buddyID, ph,vssSend->C, (vssSend->a)(firstZr), sysparams.use_commitment_digests());
+							vector<int> msgIDs;
+							buddyset.broadcast(activeNodes, vssEcho, &alphas, &msgIDs);
+							gettimeofday (&now, NULL);
+							for(size_t i = 0; i < activeNodes.size(); ++i)
+								msgLog << "VSS_ECHO " << msgIDs[i] << " for " << vssEcho.dealer << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+						} else for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
   							Zr nodeZr = Zr(sysparams.get_Pairing(),(long int)*iter);
 							Zr alpha = (vssSend->a)(nodeZr);												
 							gettimeofday (&now, NULL);
 							//if (*iter != selfID){
-							VSSEchoMessage vssEcho(buddyID, ph,vssSend->C, alpha);
+							vssSend->C.setAuthPaths(*iter);
+							VSSEchoMessage vssEcho(buddyset, buddyID, ph,vssSend->C, alpha);
 							buddyset.send_message(*iter, vssEcho);
 							gettimeofday (&now, NULL);
 							msgLog << "VSS_ECHO " << vssEcho.get_ID() << " for " << vssEcho.dealer << " SENT from " << selfID << " to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
@@ -378,6 +508,10 @@ int Node::run()
 
 			gettimeofday(&now, NULL);
 			msgLog << "VSS_ECHO " << vssEcho->get_ID() << " for " << vssEcho -> dealer << " RECEIVED from " << buddyID << " to " << selfID << " at " << now.tv_sec << "." << setw(6) << now.tv_usec << endl;
+			if (vssEcho->missing.size() && vssEcho->ph == ph) {
+				waitForCommitment(buddyID, vssEcho->dealer, *vssEcho, vssEcho->missing);
+				break;
+			}
 			//vssEcho->alpha.dump(stderr,"Alpha received is");
 
 			//if (selfID == buddyset.get_leader()) {
@@ -393,7 +527,7 @@ int Node::run()
 			} else if((nodeState != DKG_COMPLETED)&&
 				//condition below make sure that if the DKG is complete, then VSS only for NodeID the decided set continue
 				((nodeState!=AGREEMENT_COMPLETED)||(find(DecidedVSSs.begin(),DecidedVSSs.end(),vssEcho->dealer)!= DecidedVSSs.end()))){
-				if(vssEcho->C.verifyPoint(sysparams,buddyID,selfID,vssEcho->alpha)){
+				if(verifyAtThreshold || vssEcho->C.verifyPoint(sysparams,buddyID,selfID,vssEcho->alpha)){
 					//Echo message from the same phase and message verified
 					multimap<NodeID, Commitment>::iterator it;
 					pair<multimap<NodeID, Commitment>::iterator, multimap<NodeID, Commitment>::iterator> ret;					
@@ -414,7 +548,10 @@ int Node::run()
 						//cerr<<vssEcho->dealer<<" inserted with Echo\n";
 				
 					//Add share and increase Echo count in commitment matrix 	
-					if (!it->second.addEchoMsg(buddyID, vssEcho->alpha)) {
+					bool added = verifyAtThreshold?
+						it->second.addUnverifiedMsg(sysparams, false, buddyID, vssEcho->alpha, vssEcho->C) :
+						it->second.addEchoMsg(buddyID, vssEcho->alpha);
+					if (!added) {
 						// msgLog << "* Replicated Echo Message" << endl;
 						break;
 						// This is NOT the first echo message from sender for dealer
@@ -425,9 +562,15 @@ int Node::run()
 				//	cout << "Threshold = " << echo_threshold << endl;
 					if((it->second.getEchoMsgCnt() == echo_threshold) && (it->second.getReadyMsgCnt() < sysparams.get_t() + 1)){
 						bool EchoOrReady = false;//EchoOrReady = Echo					
-						vector<Zr> subshares = it->second.interpolate(sysparams,EchoOrReady,activeNodes);
-						if (commType == Feldman_Vector)		
-							it->second.setSubshares(sysparams,subshares);
+						vector<Zr> subshares;
+						if (verifyAtThreshold) {
+							//Bad points were dropped; wait for more echoes
+							if (!it->second.verifyShares(sysparams,selfID,EchoOrReady,activeNodes,subshares)) break;
+						} else {
+							subshares = it->second.interpolate(sysparams,EchoOrReady,activeNodes);
+							if (commType == Feldman_Vector)		
+								it->second.setSubshares(sysparams,subshares);
+						}
 
 						msgLog << endl << endl << endl;
 						msgLog << "============================================" << endl;
@@ -439,9 +582,22 @@ int Node::run()
 
 						vector<NodeID>::const_iterator iter;//For the active nodes list					
 						unsigned int index = 0;//Note that starting with zero as first the value is an evaluation at zero
-						for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
+						if (it->second.get_Type() == Feldman_Matrix && activeNodes.size()){
+							//Only the subshare differs between the readies, so
+							//the commitment is serialized (and signed) once
+							vector<string> alphas(activeNodes.size());
+							for(size_t i = 0; i < activeNodes.size(); ++i)
+								write_Zr(alphas[i], subshares[i+1]);
+							VSSReadyMessage vssReady(buddyset,it->first, ph, it->second, subshares[1], true, sysparams.use_commitment_digests());
+							vector<int> msgIDs;
+							buddyset.broadcast(activeNodes, vssReady, &alphas, &msgIDs);
+							gettimeofday (&now, NULL);
+							for(size_t i = 0; i < activeNodes.size(); ++i)
+								msgLog << "VSS_READY " << msgIDs[i] << " for " << vssReady.dealer << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+						} else for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
 							//if (*iter != selfID){
 							++index;
+							it->second.setAuthPaths(*iter);
 							VSSReadyMessage vssReady(buddyset,it->first, ph, it->second, subshares[index]);	
 							buddyset.send_message(*iter, vssReady);
 							gettimeofday (&now, NULL);
@@ -457,6 +613,10 @@ int Node::run()
 			gettimeofday(&now, NULL);
 			msgLog << "VSS_READY " << vssReady ->get_ID() << " for " << vssReady -> dealer << " RECEIVED from " << buddyID << " to " << selfID
 					<< " at " << now.tv_sec << "." << setw(6) << now.tv_usec << endl;
+			if (vssReady->missing.size() && vssReady->ph == ph) {
+				waitForCommitment(buddyID, vssReady->dealer, *vssReady, vssReady->missing);
+				break;
+			}
 
 			//if (selfID == buddyset.get_leader()) {
 		//	}
@@ -471,7 +631,7 @@ int Node::run()
 			} else if((vssReady->msgValid)&&(nodeState!=DKG_COMPLETED)&&
 				//condition below make sure that if the DKG is complete, then VSS only for NodeID the decided set continue
 					((nodeState!=AGREEMENT_COMPLETED)||(find(DecidedVSSs.begin(),DecidedVSSs.end(),vssReady->dealer)!= DecidedVSSs.end()))){
-				if(vssReady->C.verifyPoint(sysparams, buddyID, selfID, vssReady->alpha)){	
+				if(verifyAtThreshold || vssReady->C.verifyPoint(sysparams, buddyID, selfID, vssReady->alpha)){	
 					multimap<NodeID, Commitment>::iterator it;
 					pair<multimap<NodeID, Commitment>::iterator, multimap<NodeID, Commitment>::iterator> ret;					
 					bool commitmentAlreadyExists = false;
@@ -487,7 +647,10 @@ int Node::run()
 						it = C.insert(make_pair(vssReady->dealer, vssReady->C));
 						//cerr<<vssReady->dealer<<" inserted with Ready\n";
 					//Add ready share and increase ready count	
-					if (!it->second.addReadyMsg(buddyID, vssReady->alpha)) {
+					bool added = verifyAtThreshold?
+						it->second.addUnverifiedMsg(sysparams, true, buddyID, vssReady->alpha, vssReady->C) :
+						it->second.addReadyMsg(buddyID, vssReady->alpha);
+					if (!added) {
 						// msgLog << "* NOT first time seen the ready message" << endl;
 						break;
 					}
@@ -509,8 +672,13 @@ int Node::run()
 					//cout << "Current Echo and ready count is "<< it->second.getEchoMsgCnt()<<" "<<it->second.getReadyMsgCnt()<<endl;	 
 					if((it->second.getEchoMsgCnt() < echo_threshold)&&(it->second.getReadyMsgCnt() == sysparams.get_t() + 1)){
 						bool EchoOrReady = true;//EchoOrReady = Ready					
-						vector<Zr> subshares = it->second.interpolate(sysparams, EchoOrReady, activeNodes);					
-						if (commType == Feldman_Vector)	it->second.setSubshares(sysparams,subshares);
+						vector<Zr> subshares;
+						if (verifyAtThreshold) {
+							if (!it->second.verifyShares(sysparams,selfID,EchoOrReady,activeNodes,subshares)) break;
+						} else {
+							subshares = it->second.interpolate(sysparams, EchoOrReady, activeNodes);					
+							if (commType == Feldman_Vector)	it->second.setSubshares(sysparams,subshares);
+						}
 					
 						msgLog << endl << endl << endl;
 						msgLog << "============================================" << endl;
@@ -523,9 +691,22 @@ int Node::run()
 
 						vector<NodeID>::iterator iter;//For the active nodes list					
 						unsigned short index = 0;//Note that starting with zero as first the value is an evaluation at zero
-						for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
+						if (it->second.get_Type() == Feldman_Matrix && activeNodes.size()){
+							//Only the subshare differs between the readies, so
+							//the commitment is serialized (and signed) once
+							vector<string> alphas(activeNodes.size());
+							for(size_t i = 0; i < activeNodes.size(); ++i)
+								write_Zr(alphas[i], subshares[i+1]);
+							VSSReadyMessage vssReady(buddyset,it->first, ph, it->second, subshares[1], true, sysparams.use_commitment_digests());
+							vector<int> msgIDs;
+							buddyset.broadcast(activeNodes, vssReady, &alphas, &msgIDs);
+							gettimeofday (&now, NULL);
+							for(size_t i = 0; i < activeNodes.size(); ++i)
+								msgLog << "VSS_READY " << msgIDs[i] << " for " << vssReady.dealer << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+						} else for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
 							//if (*iter != selfID){
 							++index;
+							it->second.setAuthPaths(*iter);
 							VSSReadyMessage vssReady(buddyset,it->first, ph, it->second, subshares[index]);	
 							buddyset.send_message(*iter, vssReady);
 							gettimeofday (&now, NULL);
@@ -536,12 +717,15 @@ int Node::run()
 
 						vector <NodeID> zero; //zero.push_back(0);Zero is anyways computed
 						bool EchoOrReady = true;//EchoOrReady = Ready
+						//Normally the row is verified by now and every ready point was checked against it
+						if (verifyAtThreshold && !it->second.verifyPending(sysparams, selfID, EchoOrReady)) break;
 						vector<Zr> subshare = it->second.interpolate(sysparams, EchoOrReady, zero);
 						
 						//Add the commitment and the subshare to final set C_final
 						CommitmentAndShare mns; mns.C = it->second; mns.share = subshare[0];
 						//Note that I might like to remove ECHO and READY shares from Matrix object
 						C_final.insert(make_pair(it->first, mns));
+						dropParked(false, it->first);
 						
 						bool changed = false;
 						if(NodeIDSize(vssReadyMsgSelected.size()) < sysparams.get_t() + 1) {
@@ -566,7 +750,7 @@ int Node::run()
 						//to be considered
 					if (nodeState != AGREEMENT_COMPLETED) {					
 						if(selfID != buddyset.get_leader() && nodeState != AGREEMENT_STARTED){
-							VSSSharedMessage vssShared(ph, it->first,ready_it->first,ready_it->second);
+							VSSSharedMessage vssShared(buddyset, ph, it->first,ready_it->first,ready_it->second);
 							buddyset.send_message(buddyset.get_leader(), vssShared);
 							gettimeofday (&now, NULL);
 							msgLog << "VSS_SHARED " << vssShared.get_ID() << " for " << vssShared.dealer << " SENT from " << selfID << " to " << buddyset.get_leader() << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
@@ -596,6 +780,67 @@ int Node::run()
 			buddy->help(msgLog);
 		}
 		break;		
+		case VSS_COMMITMENT_REQUEST:{
+			VSSCommitmentRequestMessage *request = static_cast<VSSCommitmentRequestMessage*>(nm);
+			//A short request gets a large reply; answer each node once
+			string requested;
+			if (buddyset.get_commitments().recall_string(request->digest, requested) &&
+				answeredC[request->digest].insert(buddyID).second) {
+				VSSCommitmentMessage reply(requested);
+				buddyset.send_message(buddyID, reply);
+			}
+		}
+		break;
+		case VSS_COMMITMENT:{
+			VSSCommitmentMessage *vssCommitment = static_cast<VSSCommitmentMessage*>(nm);
+			//Only taken if we asked for it
+			if (waitingForC.count(vssCommitment->C.digest()))
+				commitmentArrived(vssCommitment->C);
+		}
+		break;
+		case VSS_SEND_FRAGMENT:{
+			VSSFragmentMessage *vssFragment = static_cast<VSSFragmentMessage*>(nm);
+			gettimeofday(&now, NULL);
+			msgLog << "VSS_SEND_FRAGMENT " << vssFragment->get_ID() << " for * RECEIVED from " << buddyID << " to " << selfID << " at " << now.tv_sec << "." << setw(6) << now.tv_usec << endl;
+			if (vssFragment->ph != ph || vssFragment->dealer != buddyID) break;
+			if (!checkFragment(selfID, *vssFragment)) {
+				cerr<<"Error with the VSS_SEND_FRAGMENT message received at "<<selfID<<" from "<<buddyID<<endl;
+				break;
+			}
+			if (fragmentPolys.count(buddyID)) break;//Honest dealers send one
+			fragmentPolys[buddyID] = make_pair(vssFragment->root, vssFragment->a);
+
+			//Pass our fragment on, so that everybody can put the commitment together
+			VSSFragmentMessage vssPass(buddyID, ph, vssFragment->root, vssFragment->count,
+									   vssFragment->length, vssFragment->index,
+									   vssFragment->fragment, vssFragment->proof);
+			vector<int> msgIDs;
+			buddyset.broadcast(activeNodes, vssPass, NULL, &msgIDs);
+			gettimeofday (&now, NULL);
+			for(size_t i = 0; i < activeNodes.size(); ++i)
+				msgLog << "VSS_FRAGMENT " << msgIDs[i] << " for " << buddyID << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+			//The others' fragments may have been enough already
+			sendFromFragments(buddyID);
+		}
+		break;
+		case VSS_FRAGMENT:{
+			VSSFragmentMessage *vssFragment = static_cast<VSSFragmentMessage*>(nm);
+			gettimeofday(&now, NULL);
+			msgLog << "VSS_FRAGMENT " << vssFragment->get_ID() << " for " << vssFragment->dealer << " RECEIVED from " << buddyID << " to " << selfID << " at " << now.tv_sec << "." << setw(6) << now.tv_usec << endl;
+			if (vssFragment->ph != ph) break;
+			if (!checkFragment(buddyID, *vssFragment)) {
+				cerr<<"Error with the VSS_FRAGMENT message received at "<<selfID<<" from "<<buddyID<<endl;
+				break;
+			}
+			//One fragment per sender and dealer
+			if (!fragmentSenders[vssFragment->dealer].insert(buddyID).second) break;
+			FragmentSet &fragments = fragmentSets[vssFragment->root];
+			if (fragments.assembled) break;
+			fragments.pieces[vssFragment->index] = vssFragment->fragment;
+			if ((NodeIDSize)fragments.pieces.size() == sysparams.get_t() + 1)
+				assembleCommitment(vssFragment->dealer, vssFragment->root, vssFragment->length);
+		}
+		break;
 		case VSS_SHARED:{
 			VSSSharedMessage *vssShared = static_cast<VSSSharedMessage*>(nm);
 			//cerr << "VSS_SHARED for " << vssShared->dealer << " RECEIVED from " << buddyID << " to " << selfID << endl;
@@ -619,14 +864,14 @@ int Node::run()
 				if (ready_it == vssReadyMsg.end())//No entry for this dealer
 					vssReadyMsg.insert(make_pair(vssShared->readyMsg,vssShared->msgDSAs));					
 				else//Entry for this dealer exists. add the received ready messages 
-					ready_it->second.insert(vssShared->msgDSAs.begin(), vssShared->msgDSAs.end());
+					merge_sigs(ready_it->second, vssShared->msgDSAs);
 				
 				if(NodeIDSize(vssReadyMsgSelected.size()) < sysparams.get_t() + 1){
 					ready_it = vssReadyMsgSelected.find(vssShared->readyMsg);
 					if (ready_it == vssReadyMsgSelected.end())//No entry for this dealer
 						vssReadyMsgSelected.insert(make_pair(vssShared->readyMsg,vssShared->msgDSAs));					
 					else//Entry for this dealer exists. add the received ready messages 
-						ready_it->second.insert(vssShared->msgDSAs.begin(), vssShared->msgDSAs.end());
+						merge_sigs(ready_it->second, vssShared->msgDSAs);
 					if (NodeIDSize(vssReadyMsgSelected.size()) == sysparams.get_t() + 1) {
 						startAgreement();
 					}
@@ -665,13 +910,13 @@ int Node::run()
 					if (dkgReadyValidityMsg.DecidedVSSs.empty() ||(dkgReadyValidityMsg.DecidedVSSs == Q)){
 						// Q is equivalent to Ready message sent during last leader 
 						// or no leader sent during last leader, so accept the valid set from the leader and send Echo
-						vector<NodeID>::iterator iter;//For the active nodes list
-						for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-							//if (*iter != selfID){
-							DKGEchoMessage dkgEcho(buddyset, buddyset.get_leader(), ph, Q);
-							buddyset.send_message(*iter, dkgEcho);
-							gettimeofday (&now, NULL);
-							msgLog << "DKG_ECHO " << dkgEcho.get_ID() << " for " << dkgEcho.leader << " SENT from " << selfID << " to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+						//The echo is the same for everybody, so it is signed once
+						DKGEchoMessage dkgEcho(buddyset, buddyset.get_leader(), ph, Q);
+						vector<int> msgIDs;
+						buddyset.broadcast(activeNodes, dkgEcho, NULL, &msgIDs);
+						gettimeofday (&now, NULL);
+						for(size_t i = 0; i < activeNodes.size(); ++i){
+							msgLog << "DKG_ECHO " << msgIDs[i] << " for " << dkgEcho.leader << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
 						}
 					}				
 				} //else //DKGsend is invalid, send LeaderChangeMessage
@@ -732,14 +977,12 @@ int Node::run()
 					msgLog << "============================================" << endl << endl;
 
 										
-					vector<NodeID>::iterator iter;//For the active nodes list					
-					for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-						//if (*iter != selfID){
-						DKGReadyMessage dkgReady(buddyset, buddyset.get_leader(),ph,dkgEcho->DecidedVSSs);
-						buddyset.send_message(*iter, dkgReady);	
-						//cerr<<"DKGReady message is sent to Node "<<*iter<<".\n";
-						gettimeofday (&now, NULL);
-						msgLog << "DKG_READY " << dkgReady.get_ID() << " for " << dkgReady.leader << " SENT from " << selfID << " to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+					DKGReadyMessage dkgReady(buddyset, buddyset.get_leader(),ph,dkgEcho->DecidedVSSs);
+					vector<int> msgIDs;
+					buddyset.broadcast(activeNodes, dkgReady, NULL, &msgIDs);
+					gettimeofday (&now, NULL);
+					for(size_t i = 0; i < activeNodes.size(); ++i){
+						msgLog << "DKG_READY " << msgIDs[i] << " for " << dkgReady.leader << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
 					}
 				}			
 			}else if (!dkgEcho->msgValid) {
@@ -800,14 +1043,13 @@ int Node::run()
 					msgLog << "============================================" << endl << endl;
 
 
-					vector<NodeID>::iterator iter;//For the active nodes list					
-					for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-						//if (*iter != selfID){
-						DKGReadyMessage dkgReadySent(buddyset, buddyset.get_leader(),ph,dkgReady->DecidedVSSs);
-						buddyset.send_message(*iter, dkgReadySent);	
-						gettimeofday (&now, NULL);
-						msgLog << "DKG_READY " << dkgReadySent.get_ID() << " for " << dkgReadySent.leader << " SENT from " << selfID <<
-											" to " << *iter << " at " <<  now.tv_sec << "." << setw(6) <<
+					DKGReadyMessage dkgReadySent(buddyset, buddyset.get_leader(),ph,dkgReady->DecidedVSSs);
+					vector<int> msgIDs;
+					buddyset.broadcast(activeNodes, dkgReadySent, NULL, &msgIDs);
+					gettimeofday (&now, NULL);
+					for(size_t i = 0; i < activeNodes.size(); ++i){
+						msgLog << "DKG_READY " << msgIDs[i] << " for " << dkgReadySent.leader << " SENT from " << selfID <<
+											" to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) <<
 											now.tv_usec << " standard 1" << endl;
 					}									
 				}else if((NodeIDSize)ready_it->second.size() == sysparams.get_n() - sysparams.get_t() - sysparams.get_f()){
@@ -896,14 +1138,14 @@ int Node::run()
 							if (it == vssReadyMsg.end())//No entry for this dealer in local vssReadyMsg
 								it = vssReadyMsg.insert(make_pair(it_received->first,it_received->second)).first;
 							else//Entry for this dealer exists. add the received ready messages 
-								it->second.insert(it_received->second.begin(), it_received->second.end());
+								merge_sigs(it->second, it_received->second);
 							//Copy to vssReadyMsgSelected
 							if (NodeIDSize(vssReadyMsgSelected.size()) < sysparams.get_t() + 1){
 								it = vssReadyMsgSelected.find(it_received->first);
 								if (it == vssReadyMsgSelected.end())//No entry for this dealer in local vssReadyMsg
 									it = vssReadyMsgSelected.insert(make_pair(it_received->first,it_received->second)).first;
 								else//Entry for this dealer exists. add the received ready messages 
-									it->second.insert(it_received->second.begin(), it_received->second.end());								
+									merge_sigs(it->second, it_received->second);								
 							}
 						}
 					}else {
@@ -1061,44 +1303,139 @@ int Node::run()
   	}
   	delete m;
   	//cerr<<endl;  	
-  }//Check with Ian about the return value
-  return 1;
 }
 
 void Node::hybridVSSInit(const Zr& secret){
-
-  	//const Pairing& e = sysparams.get_Pairing();
-  	unsigned short t = sysparams.get_t();
-
 	timeval now;
-	
   	gettimeofday (&now, NULL);
   	msgLog << "COMPUTE_BI * for * RS from " << selfID << " to * at " << now.tv_sec <<
   			"." << setw(6) << now.tv_usec << endl;
-	BiPolynomial fxy(sysparams, t, secret);
+	sendDealing(makeDealing(secret));
+}
+
+void Node::hybridVSSInit(){
+	pthread_mutex_lock(&dealerMutex);
+	//A dealing under way is nearer done than one started here
+	while (dealingPool.empty() && dealerBusy)
+		pthread_cond_wait(&dealerCond, &dealerMutex);
+	//Dealings made for a different set of nodes are of no use
+	while (!dealingPool.empty() && (dealingPool.front().activeNodes != activeNodes ||
+									dealingPool.front().commType != commType))
+		dealingPool.pop_front();
+	bool precomputed = !dealingPool.empty();
+	Dealing dealing;
+	if (precomputed) {
+		dealing = dealingPool.front();
+		dealingPool.pop_front();
+		pthread_cond_broadcast(&dealerCond);//Make another
+	}
+	pthread_mutex_unlock(&dealerMutex);
 
+	if (!precomputed) {
+		hybridVSSInit(Zr(sysparams.get_Pairing(), true));
+		return;
+	}
+	timeval now;
 	gettimeofday (&now, NULL);
-	msgLog << "COMPUTE_CM * for * RS from " << selfID << " to * at " << now.tv_sec <<
-	  			"." << setw(6) << now.tv_usec << endl;
+	msgLog << "PRECOMPUTED_DEALING * for * RS from " << selfID << " to * at " << now.tv_sec <<
+			"." << setw(6) << now.tv_usec << endl;
+	sendDealing(dealing);
+}
+
+void *Node::launch_dealer(void *arg){
+	((Node *)arg)->dealer();
+	return NULL;
+}
+
+//Keeps the pool full. The Pairing is safe to share between threads.
+void Node::dealer(){
+	pthread_mutex_lock(&dealerMutex);
+	while (!dealerStopping) {
+		if (dealingPool.size() >= DEALING_POOL_SIZE) {
+			pthread_cond_wait(&dealerCond, &dealerMutex);
+			continue;
+		}
+		dealerBusy = true;
+		pthread_mutex_unlock(&dealerMutex);
+		Dealing dealing = makeDealing(Zr(sysparams.get_Pairing(), true));
+		pthread_mutex_lock(&dealerMutex);
+		dealerBusy = false;
+		dealingPool.push_back(dealing);
+		pthread_cond_broadcast(&dealerCond);
+	}
+	pthread_mutex_unlock(&dealerMutex);
+}
 
-  	Commitment C(sysparams,activeNodes, fxy, commType);
+Node::~Node(){
+	if (dealerRunning) {
+		pthread_mutex_lock(&dealerMutex);
+		dealerStopping = true;
+		pthread_cond_broadcast(&dealerCond);
+		pthread_mutex_unlock(&dealerMutex);
+		pthread_join(dealerThread, NULL);
+	}
+	pthread_mutex_destroy(&dealerMutex);
+	pthread_cond_destroy(&dealerCond);
+}
+
+const Dealing Node::makeDealing(const Zr& secret) const{
+	Dealing dealing;
+	dealing.activeNodes = activeNodes;
+	dealing.commType = commType;
 
+  	//const Pairing& e = sysparams.get_Pairing();
+  	unsigned short t = sysparams.get_t();
+	BiPolynomial fxy(sysparams, t, secret);
+  	dealing.C = Commitment(sysparams,activeNodes, fxy, commType);
+
+	vector<NodeID>::const_iterator iter;
+	for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
+		Zr nodeZr = Zr(sysparams.get_Pairing(),(long int)*iter);
+		dealing.polys.push_back(fxy(nodeZr));
+	}
+	return dealing;
+}
+
+void Node::sendDealing(const Dealing& dealing){
+	timeval now;
   //sending send messages
-  vector<NodeID>::iterator iter;
   //cerr << "Sending sharing secret" << endl;
-  for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-  	Zr nodeZr = Zr(sysparams.get_Pairing(),(long int)*iter);
-	Polynomial a = fxy(nodeZr);
-	//if (*iter != selfID){
-	//a.dump(stderr,"Poly to be send");
-	VSSSendMessage vssSend(ph,C,a);
-	buddyset.send_message(*iter, vssSend);
+  if (dealing.activeNodes.empty()) return;
+  if (sysparams.use_commitment_fragments() && dealing.C.get_Type() == Feldman_Matrix &&
+	  dealing.activeNodes.size() <= FRAGMENT_MAX_COUNT) {
+	//Each node gets one fragment of the commitment, any t+1 of which give
+	//it back, and puts it together from the fragments the others pass on
+	string commitmentStr = dealing.C.toString();
+	vector<string> fragments = rs_encode(commitmentStr, sysparams.get_t() + 1,
+										 dealing.activeNodes.size());
+	vector<vector<string> > proofs;
+	string root = fragment_root(fragments, commitmentStr.length(), &proofs);
+	buddyset.get_commitments().remember(dealing.C);//Nodes may still ask for it by digest
+	for(size_t i = 0; i < dealing.activeNodes.size(); ++i){
+		VSSFragmentMessage vssFragment(selfID, ph, root, dealing.activeNodes.size(),
+									   commitmentStr.length(), i, fragments[i], proofs[i],
+									   &dealing.polys[i]);
+		buddyset.send_message(dealing.activeNodes[i], vssFragment);
+		gettimeofday (&now, NULL);
+		msgLog << "VSS_SEND_FRAGMENT " << vssFragment.get_ID() << " for " << "* SENT from " << selfID <<
+				" to " << dealing.activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec
+				<< " standard 1" << endl;
+	}
+	return;
+  }
+  //The commitment is the same for everybody; each gets its own polynomial
+  vector<string> polyStrs(dealing.activeNodes.size());
+  for(size_t i = 0; i < dealing.activeNodes.size(); ++i)
+	write_Poly(polyStrs[i], dealing.polys[i]);
+  VSSSendMessage vssSend(ph,dealing.C,dealing.polys.front());
+  vector<int> msgIDs;
+  buddyset.broadcast(dealing.activeNodes, vssSend, &polyStrs, &msgIDs);
 
-	gettimeofday (&now, NULL);
-	msgLog << "VSS_SEND " << vssSend.get_ID() << " for " << "* SENT from " << selfID <<
-			" to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec
+  gettimeofday (&now, NULL);
+  for(size_t i = 0; i < dealing.activeNodes.size(); ++i){
+	msgLog << "VSS_SEND " << msgIDs[i] << " for " << "* SENT from " << selfID <<
+			" to " << dealing.activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec
 			<< " standard 1" << endl;
-
   }					
 	//  cerr << endl << endl;
 }
@@ -1139,24 +1476,24 @@ void Node::startAgreement(){
 		
 			
 		if (dkgReadyValidityMsgDSAs.size()){//DKGEcho or DKGReady are from the previous leader are used
-			for(vector<NodeID>::iterator iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-				//if (*iter != selfID){
-				DKGSendMessage dkgSend(ph,it_leadchg->first ,it_leadchg->second, (NetworkMessageType)dkgReadyValidityMsg.strMsg[0],
-										dkgReadyValidityMsg, dkgReadyValidityMsgDSAs);
-				buddyset.send_message(*iter, dkgSend);	
-				gettimeofday (&now, NULL);
-				msgLog << "DKG_SEND " << dkgSend.get_ID() << " for " << "* SENT from " << selfID <<
-						" to " << *iter << " at " <<  now.tv_sec << "." << setw(6) <<
+			DKGSendMessage dkgSend(buddyset, ph,it_leadchg->first ,it_leadchg->second, (NetworkMessageType)dkgReadyValidityMsg.strMsg[0],
+									dkgReadyValidityMsg, dkgReadyValidityMsgDSAs);
+			vector<int> msgIDs;
+			buddyset.broadcast(activeNodes, dkgSend, NULL, &msgIDs);
+			gettimeofday (&now, NULL);
+			for(size_t i = 0; i < activeNodes.size(); ++i){
+				msgLog << "DKG_SEND " << msgIDs[i] << " for " << "* SENT from " << selfID <<
+						" to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) <<
 						now.tv_usec << " standard 1" << endl;
 			}		 	
 		} else{//VSSReady are used
-		 	for(vector<NodeID>::iterator iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-				//if (*iter != selfID){
-				DKGSendMessage dkgSend(ph, it_leadchg->first ,it_leadchg->second, vssReadyMsgSelected);
-				buddyset.send_message(*iter, dkgSend);
-				gettimeofday (&now, NULL);
-				msgLog << "DKG_SEND " << dkgSend.get_ID() <<  " for " << "* SENT from " << selfID <<
-						" to " << *iter << " at " <<  now.tv_sec << "." << setw(6) <<
+			DKGSendMessage dkgSend(buddyset, ph, it_leadchg->first ,it_leadchg->second, vssReadyMsgSelected);
+			vector<int> msgIDs;
+			buddyset.broadcast(activeNodes, dkgSend, NULL, &msgIDs);
+			gettimeofday (&now, NULL);
+			for(size_t i = 0; i < activeNodes.size(); ++i){
+				msgLog << "DKG_SEND " << msgIDs[i] <<  " for " << "* SENT from " << selfID <<
+						" to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) <<
 						now.tv_usec << " standard 1" << endl;
 			}
   		}
@@ -1221,6 +1558,7 @@ void Node::completeDKG(){
 				<< now.tv_sec << "." << setw(6) << now.tv_usec << " :)" <<endl;
 	//DecidedVSSs broadcast and decided VSSs are now completed
 	nodeState = DKG_COMPLETED;
+	dropParked(true);//No sharing needs them now
 	result.share.dump(stderr,(char*)"Share is ",10);
 	FILE *fout = fopen("keys.out","w");
 	if (fout) {
@@ -1245,39 +1583,218 @@ void Node::sendLeaderChangeMessage(NodeID nextLeader){
 	
 	if ((nodeState != LEADER_CHANGE_STARTED)&&(nodeState != DKG_COMPLETED)){
 		//sending LeaderChange messages
-		vector<NodeID>::iterator iter; 
-		if (dkgReadyValidityMsgDSAs.size()){
-			for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-				//if (*iter != selfID){
-				LeaderChangeMessage leadChg = LeaderChangeMessage(buddyset,ph, nextLeader, (NetworkMessageType)dkgReadyValidityMsg.strMsg[0], dkgReadyValidityMsg,dkgReadyValidityMsgDSAs);
-				buddyset.send_message(*iter, leadChg);
-				gettimeofday (&now, NULL);
-				msgLog << "LEADER_CHANGE " << leadChg.get_ID() << " for " << nextLeader << " SENT from " << selfID << " to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
-  			}		 	
-		 } else{ 
-			for(iter = activeNodes.begin();iter != activeNodes.end(); ++iter){
-				//if (*iter != selfID){
-				LeaderChangeMessage leadChg = LeaderChangeMessage(buddyset,ph, nextLeader, vssReadyMsgSelected);
-				buddyset.send_message(*iter, leadChg);
-				gettimeofday (&now, NULL);
-				msgLog << "LEADER_CHANGE " << leadChg.get_ID() << " for " << nextLeader << " SENT from " << selfID << " to " << *iter << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
-			}
-  		}
+		//The message is the same for everybody, so it is signed once
+		LeaderChangeMessage leadChg = dkgReadyValidityMsgDSAs.size() ?
+			LeaderChangeMessage(buddyset,ph, nextLeader, (NetworkMessageType)dkgReadyValidityMsg.strMsg[0], dkgReadyValidityMsg,dkgReadyValidityMsgDSAs) :
+			LeaderChangeMessage(buddyset,ph, nextLeader, vssReadyMsgSelected);
+		vector<int> msgIDs;
+		buddyset.broadcast(activeNodes, leadChg, NULL, &msgIDs);
+		gettimeofday (&now, NULL);
+		for(size_t i = 0; i < activeNodes.size(); ++i){
+			msgLog << "LEADER_CHANGE " << msgIDs[i] << " for " << nextLeader << " SENT from " << selfID << " to " << activeNodes[i] << " at " <<  now.tv_sec << "." << setw(6) << now.tv_usec << " standard 1" << endl;
+		}
   		nodeState = LEADER_CHANGE_STARTED;
 	}
 }
 
+// Park an echo or ready until the commitment it names turns up. Up to f+1
+// of the senders are asked for it, so that one honest node is among them.
+// Anyone can name a digest, so only as many messages are parked as honest
+// nodes would send, and only for sharings still going on.
+void Node::waitForCommitment(NodeID from, NodeID dealer, const NetworkMessage& nm,
+							 const string& digest){
+	if (!sharingOpen(dealer)) return;
+	size_t &fromCount = parkedFrom[from];
+	if (fromCount >= PARKED_PER_SENDER_AND_DIGEST * activeNodes.size()) return;
+	vector <ParkedMsg> &waiting = waitingForC[digest];
+	size_t fromDigest = 0;
+	vector <ParkedMsg>::const_iterator it;
+	for (it = waiting.begin(); it != waiting.end(); ++it)
+		if (it->from == from) ++fromDigest;
+	if (fromDigest >= PARKED_PER_SENDER_AND_DIGEST) return;
+
+	ParkedMsg parked;
+	parked.from = from;
+	parked.dealer = dealer;
+	parked.ID = nm.get_ID();
+	parked.str = nm.get_netMsgStr();
+	waiting.push_back(parked);
+	++fromCount;
+
+	set <NodeID> &asked = askedForC[digest];
+	if ((NodeIDSize)asked.size() <= sysparams.get_f() && asked.insert(from).second) {
+		VSSCommitmentRequestMessage request(digest);
+		buddyset.send_message(from, request);
+	}
+}
+
+// Remember a commitment, and replay the echoes and readies that named it
+void Node::commitmentArrived(const Commitment& commitment){
+	string digest = buddyset.get_commitments().remember(commitment);
+	map <string, vector <ParkedMsg> >::iterator waiting = waitingForC.find(digest);
+	if (waiting == waitingForC.end()) return;
+
+	vector <ParkedMsg>::const_iterator it;
+	for (it = waiting->second.begin(); it != waiting->second.end(); ++it) {
+		--parkedFrom[it->from];
+		Buddy *sender = buddyset.find_buddy_id(it->from);
+		if (!sender) continue;
+		try {
+			NetworkMessage *msg = NetworkMessage::parse_message(NODE, sender, it->str, it->ID);
+			if (msg) replay(it->from, msg);
+		} catch (const InvalidMessageException &e) {
+			cerr<<"Invalid message received from buddy id "<<it->from<< "\n";
+		}
+	}
+	waitingForC.erase(waiting);
+	askedForC.erase(digest);
+}
+
+// Whether echoes and readies for dealer are still of use
+bool Node::sharingOpen(NodeID dealer) const{
+	return nodeState != DKG_COMPLETED && !C_final.count(dealer) &&
+		find(activeNodes.begin(), activeNodes.end(), dealer) != activeNodes.end();
+}
+
+// Forget the parked messages for dealer, or all of them
+void Node::dropParked(bool all, NodeID dealer){
+	map <string, vector <ParkedMsg> >::iterator waiting = waitingForC.begin();
+	while (waiting != waitingForC.end()) {
+		vector <ParkedMsg> kept;
+		vector <ParkedMsg>::const_iterator it;
+		for (it = waiting->second.begin(); it != waiting->second.end(); ++it) {
+			if (all || it->dealer == dealer) --parkedFrom[it->from];
+			else kept.push_back(*it);
+		}
+		if (kept.empty()) {
+			askedForC.erase(waiting->first);
+			waitingForC.erase(waiting++);
+		} else {
+			waiting->second.swap(kept);
+			++waiting;
+		}
+	}
+}
+
+// A fragment is taken from the node whose position in activeNodes it has
+bool Node::checkFragment(NodeID from, const VSSFragmentMessage& fragment) const{
+	size_t pos = find(activeNodes.begin(), activeNodes.end(), from) - activeNodes.begin();
+	return fragment.index == pos && fragment.count == activeNodes.size() && fragment.check();
+}
+
+// Put a dealer's commitment together from t+1 of its fragments. It is only
+// taken if encoding it again gives the same root, so that every node that
+// puts it together ends up with the same commitment whichever fragments it used.
+void Node::assembleCommitment(NodeID dealer, const string& root, unsigned int length){
+	FragmentSet &fragments = fragmentSets[root];
+	fragments.assembled = true;
+	unsigned int k = sysparams.get_t() + 1;
+	string commitmentStr;
+	bool consistent = rs_decode(fragments.pieces, k, length, commitmentStr) &&
+		fragment_root(rs_encode(commitmentStr, k, activeNodes.size()), length) == root;
+	fragments.pieces.clear();
+	if (consistent) {
+		try {
+			const unsigned char *buf = (const unsigned char *)commitmentStr.data();
+			size_t len = commitmentStr.length();
+			fragments.C = Commitment(sysparams, buf, len);
+			consistent = fragments.C.get_Type() == Feldman_Matrix;
+		} catch (const InvalidMessageException &e) {
+			consistent = false;
+		}
+	}
+	if (!consistent) {
+		cerr<<"Fragments of the commitment from "<<dealer<<" do not fit together"<<endl;
+		return;
+	}
+	fragments.valid = true;
+	commitmentArrived(fragments.C);
+	sendFromFragments(dealer);
+}
+
+// Once its commitment is together, the dealer's polynomial for us is handled
+// as a VSS_SEND
+void Node::sendFromFragments(NodeID dealer){
+	map <NodeID, pair <string, Polynomial> >::iterator poly = fragmentPolys.find(dealer);
+	if (poly == fragmentPolys.end() || poly->second.first.empty()) return;
+	map <string, FragmentSet>::const_iterator fragments = fragmentSets.find(poly->second.first);
+	if (fragments == fragmentSets.end() || !fragments->second.assembled) return;
+	if (fragments->second.valid)
+		replay(dealer, new VSSSendMessage(ph, fragments->second.C, poly->second.second));
+	poly->second.first.clear();//Handled; the entry still keeps further ones out
+}
+
 void Node::changePhase(){
-	
+	//Echoes and readies of the old phase are of no use
+	dropParked(true);
+	answeredC.clear();
+}
+
+#define SIMULATION_LIMIT 3600000000ULL//An hour of virtual time
+
+// Run a node for every entry of the contact list in this process, over a
+// simulated network. The key for certs/x.pem is taken from certs/x-key.pem.
+static int simulate(int argc, char **argv)
+{
+  if (argc != 6 && argc != 7) {
+	cerr << "Usage: " << argv[0] << " simulate contactlist latency_ms jitter_ms bandwidth_Mbps [CommitmentType[0/1]]\n";
+	exit(1);
+  }
+  const char *contactlist = argv[2];
+  SimNetwork network;
+  network.latency = (SimTime)(atof(argv[3]) * 1000);
+  network.jitter = (SimTime)(atof(argv[4]) * 1000);
+  network.bandwidth = (unsigned long long)(atof(argv[5]) * 1000000 / 8);
+  CommitmentType type = argc == 7 ? (CommitmentType)atoi(argv[6]) : Feldman_Matrix;
+
+  // Every node has a few fds of its own
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+	rl.rlim_cur = rl.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  gnutls_global_init();
+  map<NodeID, Application*> nodes;
+  ifstream contacts(contactlist);
+  string line;
+  while (getline(contacts, line)) {
+	int id;
+	char certfile[200];
+	if (sscanf(line.c_str(), "%d %*d.%*d.%*d.%*d %*d %199s", &id, certfile) != 2)
+		continue;
+	string keyfile(certfile);
+	size_t ext = keyfile.rfind(".pem");
+	if (ext == string::npos) {
+		cerr << "No key file for " << certfile << "\n";
+		continue;
+	}
+	keyfile.replace(ext, 4, "-key.pem");
+	nodes[id] = new Node("pairing.param", "system.param", INADDR_ANY, 0,
+			certfile, keyfile.c_str(), contactlist, 0, type);
+  }
+
+  SimBus bus(network);
+  timeval start, end;
+  gettimeofday(&start, NULL);
+  bus.run(nodes, SIMULATION_LIMIT);
+  gettimeofday(&end, NULL);
+  bus.report(cout);
+  cout << "Wall clock: " << (end.tv_sec - start.tv_sec) * 1000 +
+	(end.tv_usec - start.tv_usec) / 1000 << " ms\n";
+  // The nodes are left for the exit to clean up
+  return 0;
 }
 
 int main(int argc, char **argv)
 {
   Message::init_ctr();
 
+  if (argc > 1 && !strcmp(argv[1], "simulate")) return simulate(argc, argv);
+
   Phase ph;
-  if (argc != 8) {
-	cerr << "Usage: " << argv[0] <<" portnum certfile keyfile contactlist phase CommitmentType[0/1] non_responsive_leader_number\n";
+  if (argc != 8 && argc != 9) {
+	cerr << "Usage: " << argv[0] <<" portnum certfile keyfile contactlist phase CommitmentType[0/1] non_responsive_leader_number [verify_at_threshold 0/1]\n";
 	exit(1);
   }
   in_port_t portnum = atoi(argv[1]);
@@ -1289,9 +1806,10 @@ int main(int argc, char **argv)
   CommitmentType type = (CommitmentType)atoi(argv[6]);
 
   int non_responsive_leader_number = atoi(argv[7]);
+  bool verifyAtThreshold = (argc == 9) && atoi(argv[8]);
 
   gnutls_global_init();
   Node node("pairing.param", "system.param", INADDR_ANY, portnum, 
-			certfile, keyfile, contactlist, ph, type, non_responsive_leader_number);
+			certfile, keyfile, contactlist, ph, type, non_responsive_leader_number, verifyAtThreshold);
   return node.run();
 }
@@ -64,6 +64,41 @@ Polynomial::Polynomial(const vector<Zr> coeffs)
 }
 
 
+// Create the polynomial of degree < k through the k points
+// (indices[i], evals[i]). Each Lagrange basis polynomial is the product
+// of all (x - indices[m]) divided by (x - indices[j]), so build that
+// product once and divide it out for every point.
+Polynomial::Polynomial(const vector<Zr>& indices, const vector<Zr>& evals)
+{
+    size_t k = indices.size();
+    if (!k) return;
+    Zr zero(indices[0],(long int)0);
+    for (size_t i = 0; i < k; ++i) coeffs.push_back(zero);
+
+    vector<Zr> master(1, Zr(indices[0],(long int)1));
+    for (size_t m = 0; m < k; ++m) {
+	  master.insert(master.begin(), zero);
+	  for (size_t i = 0; i + 1 < master.size(); ++i)
+		master[i] -= master[i+1]*indices[m];
+    }
+
+    for (size_t j = 0; j < k; ++j) {
+	  // Synthetic division of master by (x - indices[j])
+	  vector<Zr> basis(k, zero);
+	  Zr carry = zero;
+	  for (size_t i = k; i > 0; --i) {
+		carry = master[i] + carry*indices[j];
+		basis[i-1] = carry;
+	  }
+	  // Scale so that basis(indices[j]) = evals[j]
+	  Zr denom = zero;
+	  for (size_t i = k; i > 0; --i)
+		denom = denom*indices[j] + basis[i-1];
+	  Zr scale = evals[j]/denom;
+	  for (size_t i = 0; i < k; ++i)
+		coeffs[i] += basis[i]*scale;
+    }
+}
 
 // Copy constructor
 Polynomial::Polynomial(const Polynomial &p)
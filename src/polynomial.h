@@ -44,6 +44,10 @@ class Polynomial {
     // Create a polynomial from the a coefficient vector
     Polynomial(const vector<Zr> coeffs);
 
+    // Create the polynomial of degree < k through the k points
+    // (indices[i], evals[i]); it always has k coefficients
+    Polynomial(const vector<Zr>& indices, const vector<Zr>& evals);
+
     //Deserialization
     //  Polynomial(const SystemParam& sys, const unsigned char* buf, 
 	//		   size_t len);
@@ -0,0 +1,93 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include <iostream>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "reactor.h"
+
+using namespace std;
+
+Reactor::Reactor()
+{
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+	perror("epoll_create1");
+	exit(1);
+    }
+}
+
+Reactor::~Reactor()
+{
+    close(epfd);
+}
+
+void Reactor::add(int fd, bool out)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (out ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	if (errno == EPERM) {
+	    alwaysReady.insert(fd);
+	} else {
+	    perror("epoll_ctl");
+	}
+    }
+}
+
+void Reactor::watch(int fd, bool out)
+{
+    if (alwaysReady.count(fd)) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (out ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void Reactor::remove(int fd)
+{
+    if (alwaysReady.erase(fd)) return;
+    // The event argument is ignored, but old kernels want one
+    struct epoll_event ev;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int Reactor::wait(int timeout)
+{
+    int extra = alwaysReady.size();
+    if (extra >= REACTOR_MAX_EVENTS) extra = REACTOR_MAX_EVENTS - 1;
+    if (extra) timeout = 0;
+
+    int res = epoll_wait(epfd, events, REACTOR_MAX_EVENTS - extra, timeout);
+    if (res < 0) {
+	if (errno != EINTR) perror("epoll_wait");
+	res = 0;
+    }
+
+    for (set<int>::const_iterator it = alwaysReady.begin();
+	    it != alwaysReady.end() && extra > 0; ++it, --extra) {
+	events[res].events = EPOLLIN;
+	events[res].data.fd = *it;
+	res++;
+    }
+    return res;
+}
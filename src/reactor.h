@@ -0,0 +1,59 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#ifndef __REACTOR_H__
+#define __REACTOR_H__
+
+#include <sys/epoll.h>
+#include <set>
+
+using namespace std;
+
+#define REACTOR_MAX_EVENTS 64
+
+//The epoll set of a node: the listening socket, the user input, the
+//connections to the buddies and the sigPool pipe. It is level triggered,
+//so an fd whose event was not handled is reported again on the next wait.
+class Reactor {
+    public:
+	Reactor();
+	~Reactor();
+
+	//Watch fd for input, and for output as well if out is set
+	void add(int fd, bool out = false);
+	void watch(int fd, bool out);
+	void remove(int fd);
+	//Wait up to timeout ms (-1: no limit) and return the number of events
+	int wait(int timeout);
+	int get_fd(int i) const { return events[i].data.fd; }
+	//Hangups and errors count as readable, so the reader sees them
+	bool readable(int i) const {
+		return events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR);
+	}
+	bool writable(int i) const { return events[i].events & EPOLLOUT; }
+
+    private:
+	int epfd;
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+	//fds epoll refuses (a regular file on stdin); select() always found
+	//them readable, so they are reported on every wait
+	set<int> alwaysReady;
+};
+
+#endif
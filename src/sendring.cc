@@ -0,0 +1,123 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include "sendring.h"
+
+using namespace std;
+
+size_t OutMsg::size() const
+{
+    size_t len = 0;
+    for (int i = 0; i < npieces; i++) len += pieces[i].size();
+    return len;
+}
+
+void SendRing::push(const OutMsg &msg)
+{
+    if (count == slots.size()) grow();
+    slots[(head + count) & mask()] = msg;
+    count++;
+}
+
+void SendRing::pop()
+{
+    // Let go of the pieces now rather than when the slot is reused
+    slots[head] = OutMsg();
+    head = (head + 1) & mask();
+    count--;
+    headpos = 0;
+}
+
+int SendRing::gather(struct iovec *iov, int max, size_t from,
+	size_t upto) const
+{
+    int n = 0;
+    size_t skip = from ? 0 : headpos;
+    for (size_t i = from; i < count && i < upto && n < max; i++) {
+	const OutMsg &msg = slots[(head + i) & mask()];
+	for (int p = 0; p < msg.npieces && n < max; p++) {
+	    const MsgRef &piece = msg.pieces[p];
+	    if (skip >= piece.size()) {
+		skip -= piece.size();
+		continue;
+	    }
+	    iov[n].iov_base = (void *)(piece.data() + skip);
+	    iov[n].iov_len = piece.size() - skip;
+	    skip = 0;
+	    n++;
+	}
+    }
+    return n;
+}
+
+void SendRing::grow()
+{
+    vector<OutMsg> bigger(2 * slots.size());
+    for (size_t i = 0; i < count; i++) {
+	bigger[i] = slots[(head + i) & mask()];
+    }
+    slots.swap(bigger);
+    head = 0;
+}
+
+size_t SendQueue::size() const
+{
+    size_t total = 0;
+    for (int c = 0; c < PRIORITY_CLASSES; c++) total += rings[c].size();
+    return total;
+}
+
+void SendQueue::push(const OutMsg &msg, int priority)
+{
+    rings[priority].push(msg);
+}
+
+int SendQueue::current() const
+{
+    for (int c = 0; c < PRIORITY_CLASSES; c++) {
+	if (rings[c].started()) return c;
+    }
+    for (int c = 0; c < PRIORITY_CLASSES; c++) {
+	if (!rings[c].empty()) return c;
+    }
+    return 0;
+}
+
+int SendQueue::gather(struct iovec *iov, int max) const
+{
+    // The rest of a partly written message first
+    int started = -1;
+    int n = 0;
+    for (int c = 0; c < PRIORITY_CLASSES; c++) {
+	if (rings[c].started()) {
+	    started = c;
+	    n = rings[c].gather(iov, max, 0, 1);
+	    break;
+	}
+    }
+    for (int c = 0; c < PRIORITY_CLASSES && n < max; c++) {
+	n += rings[c].gather(iov + n, max - n, c == started ? 1 : 0);
+    }
+    return n;
+}
+
+void SendQueue::restart()
+{
+    for (int c = 0; c < PRIORITY_CLASSES; c++) rings[c].restart();
+}
@@ -0,0 +1,138 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#ifndef __SENDRING_H__
+#define __SENDRING_H__
+
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//A refcounted, immutable piece of an outgoing message, so that a body sent
+//to many buddies, or kept for VSS_HELP, is held once. Only the protocol
+//thread queues and writes messages, so the count needs no locking.
+class MsgRef {
+public:
+  MsgRef(): buf(NULL) {}
+  explicit MsgRef(const string &data): buf(new Buf(data)) {}
+  MsgRef(const MsgRef &other): buf(other.buf) { if (buf) buf->refs++; }
+  MsgRef& operator=(const MsgRef &other) {
+	if (other.buf) other.buf->refs++;
+	release();
+	buf = other.buf;
+	return *this;
+  }
+  ~MsgRef() { release(); }
+
+  const char *data() const { return buf->data.data(); }
+  size_t size() const { return buf ? buf->data.size() : 0; }
+
+private:
+  struct Buf {
+	Buf(const string &data): data(data), refs(1) {}
+	string data;
+	int refs;
+  };
+  Buf *buf;
+
+  void release() { if (buf && --buf->refs == 0) delete buf; buf = NULL; }
+};
+
+#define OUTMSG_MAX_PIECES 3
+
+//One outgoing message: a netMsgStr, or the pieces that make one up. The
+//first piece holds at least the 4 byte ID and the type byte.
+class OutMsg {
+public:
+  OutMsg(): npieces(0) {}
+  explicit OutMsg(const string &msgstr): npieces(1) { pieces[0] = MsgRef(msgstr); }
+  void add(const MsgRef &piece) { pieces[npieces++] = piece; }
+  const char *header() const { return pieces[0].data(); }
+  int type() const { return (int)header()[4]; }
+  size_t size() const;
+
+  MsgRef pieces[OUTMSG_MAX_PIECES];
+  int npieces;
+};
+
+//The messages queued for one buddy. The reactor writes as many of them as
+//the socket takes with one writev, and keeps track of how much of the
+//first one is out.
+class SendRing {
+public:
+  SendRing(): slots(SENDRING_INITIAL_SLOTS), head(0), count(0), headpos(0) {}
+
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+  void push(const OutMsg &msg);
+  const OutMsg &front() const { return slots[head]; }
+  void pop();
+  //Fill up to max iovecs with what is left to write of messages from to
+  //upto, in order
+  int gather(struct iovec *iov, int max, size_t from = 0,
+	  size_t upto = (size_t)-1) const;
+  //Whether the first message is partly written
+  bool started() const { return headpos > 0; }
+  //Bytes of the first message not written yet
+  size_t front_left() const { return front().size() - headpos; }
+  //Mark n < front_left() more bytes of the first message as written
+  void skip(size_t n) { headpos += n; }
+  //Send the first message from its start again (on a new connection)
+  void restart() { headpos = 0; }
+
+private:
+  enum { SENDRING_INITIAL_SLOTS = 16 };//a power of 2
+  vector<OutMsg> slots;
+  size_t head, count;
+  size_t headpos;
+
+  size_t mask() const { return slots.size() - 1; }
+  void grow();
+};
+
+//Message classes, most urgent first; NetworkMessage::priority() gives the
+//class of each type
+enum { PRIORITY_AGREEMENT, PRIORITY_CONTROL, PRIORITY_BULK, PRIORITY_CLASSES };
+
+//The messages queued for one buddy, a ring per class. A message goes out
+//ahead of those queued in less urgent classes, but never in the middle of
+//one that is partly written; within a class, the order is kept.
+class SendQueue {
+public:
+  bool empty() const { return size() == 0; }
+  size_t size() const;
+  void push(const OutMsg &msg, int priority);
+  const OutMsg &front() const { return rings[current()].front(); }
+  void pop() { rings[current()].pop(); }
+  //The same as for SendRing, in the order front() and pop() go through
+  int gather(struct iovec *iov, int max) const;
+  size_t front_left() const { return rings[current()].front_left(); }
+  void skip(size_t n) { rings[current()].skip(n); }
+  void restart();
+
+private:
+  SendRing rings[PRIORITY_CLASSES];
+
+  //The class of the message to write next
+  int current() const;
+};
+
+#endif
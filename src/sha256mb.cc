@@ -0,0 +1,128 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include <string.h>
+#include <stdint.h>
+#include <gcrypt.h>
+#include "sha256mb.h"
+
+//One 32 bit word from each of the eight lanes
+typedef uint32_t v8u32 __attribute__ ((vector_size (32)));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define SHA256MB_CLONES __attribute__ ((target_clones("avx2","default")))
+#else
+#define SHA256MB_CLONES
+#endif
+
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t H0[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+#define ROTR(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+//Compress one 64 byte block per lane. w holds the 16 big endian message words.
+SHA256MB_CLONES
+static void sha256_blocks8(v8u32 state[8], v8u32 w[64]){
+	for (int i = 16; i < 64; ++i){
+		v8u32 s0 = ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+		v8u32 s1 = ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+	v8u32 a = state[0], b = state[1], c = state[2], d = state[3];
+	v8u32 e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; ++i){
+		v8u32 S1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+		v8u32 ch = (e & f) ^ (~e & g);
+		v8u32 t1 = h + S1 + ch + K[i] + w[i];
+		v8u32 S0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+		v8u32 maj = (a & b) ^ (a & c) ^ (b & c);
+		v8u32 t2 = S0 + maj;
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+//Block number blk of the padded message msg
+static void padded_block(const unsigned char *msg, size_t msglen, size_t blk,
+						 unsigned char block[64]){
+	size_t start = blk*64;
+	memset(block, 0, 64);
+	if (start < msglen)
+		memcpy(block, msg + start, (msglen - start < 64)? msglen - start : 64);
+	if (msglen >= start && msglen < start + 64)
+		block[msglen - start] = 0x80;
+	size_t blocks = (msglen + 9 + 63)/64;
+	if (blk == blocks - 1){
+		uint64_t bits = (uint64_t)msglen*8;
+		for (int i = 0; i < 8; ++i)
+			block[63 - i] = (unsigned char)(bits >> (8*i));
+	}
+}
+
+void sha256_multi(const unsigned char *data, size_t msglen, size_t count,
+				  unsigned char *out){
+	size_t blocks = (msglen + 9 + 63)/64;
+	size_t full = count - count%SHA256MB_LANES;
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+	//libgcrypt's SHA-NI code beats eight AVX2 lanes; let it do all the work
+	if (__builtin_cpu_supports("sha")) full = 0;
+#endif
+	for (size_t base = 0; base < full; base += SHA256MB_LANES){
+		v8u32 state[8], w[64];
+		for (int i = 0; i < 8; ++i)
+			for (int l = 0; l < SHA256MB_LANES; ++l) state[i][l] = H0[i];
+		for (size_t blk = 0; blk < blocks; ++blk){
+			for (int l = 0; l < SHA256MB_LANES; ++l){
+				const unsigned char *msg = data + (base + l)*msglen;
+				unsigned char block[64];
+				const unsigned char *p = block;
+				if ((blk + 1)*64 <= msglen) p = msg + blk*64;//No padding in this block
+				else padded_block(msg, msglen, blk, block);
+				for (int i = 0; i < 16; ++i)
+					w[i][l] = ((uint32_t)p[4*i] << 24) | ((uint32_t)p[4*i+1] << 16) |
+							  ((uint32_t)p[4*i+2] << 8) | (uint32_t)p[4*i+3];
+			}
+			sha256_blocks8(state, w);
+		}
+		for (int l = 0; l < SHA256MB_LANES; ++l){
+			unsigned char *digest = out + (base + l)*32;
+			for (int i = 0; i < 8; ++i){
+				digest[4*i] = (unsigned char)(state[i][l] >> 24);
+				digest[4*i+1] = (unsigned char)(state[i][l] >> 16);
+				digest[4*i+2] = (unsigned char)(state[i][l] >> 8);
+				digest[4*i+3] = (unsigned char)state[i][l];
+			}
+		}
+	}
+	//Leftover messages do not fill the lanes; libgcrypt is faster for them
+	for (size_t j = full; j < count; ++j)
+		gcry_md_hash_buffer(GCRY_MD_SHA256, out + j*32, data + j*msglen, msglen);
+}
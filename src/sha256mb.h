@@ -0,0 +1,33 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#ifndef __SHA256MB_H__
+#define __SHA256MB_H__
+
+#include <stddef.h>
+
+#define SHA256MB_LANES 8
+
+//Hash count messages of msglen bytes each, stored back to back in data.
+//The 32 byte digests are written back to back into out.
+//Eight messages are hashed in lock-step; AVX2 is used when the CPU has it.
+void sha256_multi(const unsigned char *data, size_t msglen, size_t count,
+				  unsigned char *out);
+
+#endif
@@ -0,0 +1,305 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "shmlink.h"
+
+//Head and tail count bytes, wrapping at 2^32. The writer only moves head
+//and the reader only moves tail, each on its own cache line.
+struct ShmRing {
+    volatile unsigned int head;
+    char pad1[60];
+    volatile unsigned int tail;
+    char pad2[60];
+    //The reader is not looking at the ring; the writer must signal it
+    volatile unsigned int sleeping;
+    //The ring was full; the reader must signal the writer once it takes some
+    volatile unsigned int waiting;
+    char pad3[56];
+    char data[SHM_RING_SIZE];
+};
+
+#define SHM_SEGMENT_SIZE (2 * sizeof(ShmRing))
+
+// Pass fds along with one byte over a unix socket
+static bool send_fds(int sock, const int *fds, int count)
+{
+    char tag = 'S';
+    struct iovec iov;
+    iov.iov_base = &tag;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+// The number of fds received, 0 if nothing has come yet, <0 if the socket
+// is closed or the message carried none
+static int recv_fds(int sock, int *fds, int max)
+{
+    char tag;
+    struct iovec iov;
+    iov.iov_base = &tag;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t res = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (res < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    if (res == 0) return -1;
+
+    int count = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+	int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+	for (int i = 0; i < n; i++) {
+	    int fd;
+	    memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+	    if (count < max) fds[count++] = fd;
+	    else close(fd);
+	}
+    }
+    return count ? count : -1;
+}
+
+ShmLink::ShmLink(bool initiator) :
+    initiator(initiator), up(false), base(NULL), in(NULL), out(NULL),
+    myfd(-1), peerfd(-1)
+{
+}
+
+ShmLink::~ShmLink()
+{
+    if (base) munmap(base, SHM_SEGMENT_SIZE);
+    if (myfd >= 0) close(myfd);
+    if (peerfd >= 0) close(peerfd);
+}
+
+// The initiator writes to the first ring and reads the second
+bool ShmLink::map_segment(int memfd)
+{
+    struct stat st;
+    if (fstat(memfd, &st) < 0 || (size_t)st.st_size != SHM_SEGMENT_SIZE) return false;
+    void *addr = mmap(NULL, SHM_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (addr == MAP_FAILED) return false;
+    base = (char *)addr;
+    ShmRing *rings = (ShmRing *)base;
+    out = initiator ? &rings[0] : &rings[1];
+    in = initiator ? &rings[1] : &rings[0];
+    return true;
+}
+
+bool ShmLink::offer(int sock)
+{
+    int memfd = memfd_create("dkg-shm", MFD_CLOEXEC);
+    if (memfd < 0) return false;
+    bool ok = ftruncate(memfd, SHM_SEGMENT_SIZE) == 0 && map_segment(memfd);
+    if (ok) {
+	// Nobody reads either ring yet, so the first write signals
+	in->sleeping = out->sleeping = 1;
+	myfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	int fds[2] = {memfd, myfd};
+	ok = myfd >= 0 && send_fds(sock, fds, 2);
+    }
+    close(memfd);
+    return ok;
+}
+
+int ShmLink::answer(int sock)
+{
+    if (up) return 1;
+    int fds[2];
+    int count = recv_fds(sock, fds, 2);
+    if (count <= 0) return count;
+    if (initiator) {
+	if (count != 1) {
+	    for (int i = 0; i < count; i++) close(fds[i]);
+	    return -1;
+	}
+	peerfd = fds[0];
+    } else {
+	if (count != 2 || !map_segment(fds[0])) {
+	    for (int i = 0; i < count; i++) close(fds[i]);
+	    return -1;
+	}
+	close(fds[0]);
+	peerfd = fds[1];
+	myfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (myfd < 0 || !send_fds(sock, &myfd, 1)) return -1;
+    }
+    up = true;
+    return 1;
+}
+
+void ShmLink::wake(int fd)
+{
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+void ShmLink::clear()
+{
+    uint64_t count;
+    while (::read(myfd, &count, sizeof(count)) < 0 && errno == EINTR);
+}
+
+size_t ShmLink::read(char *buf, size_t len)
+{
+    unsigned int tail = in->tail;
+    __sync_synchronize();
+    size_t avail = in->head - tail;
+    if (len > avail) len = avail;
+    size_t done = 0;
+    while (done < len) {
+	size_t pos = (tail + done) & (SHM_RING_SIZE - 1);
+	size_t chunk = len - done;
+	if (chunk > SHM_RING_SIZE - pos) chunk = SHM_RING_SIZE - pos;
+	memcpy(buf + done, in->data + pos, chunk);
+	done += chunk;
+    }
+    if (!done) return 0;
+    __sync_synchronize();
+    in->tail = tail + done;
+    __sync_synchronize();
+    if (in->waiting) {
+	in->waiting = 0;
+	wake(peerfd);
+    }
+    return done;
+}
+
+bool ShmLink::sleep()
+{
+    in->sleeping = 1;
+    __sync_synchronize();
+    if (in->head == in->tail) return true;
+    in->sleeping = 0;
+    return false;
+}
+
+size_t ShmLink::writev(const struct iovec *iov, int iovcnt)
+{
+    unsigned int head = out->head;
+    size_t done = 0;
+    int i = 0;
+    size_t off = 0;
+    while (i < iovcnt) {
+	__sync_synchronize();
+	size_t room = SHM_RING_SIZE - (head - out->tail);
+	if (room == 0) {
+	    // Ask the reader to signal us, unless it made room meanwhile
+	    out->waiting = 1;
+	    __sync_synchronize();
+	    if (SHM_RING_SIZE - (head - out->tail) == 0) break;
+	    out->waiting = 0;
+	    continue;
+	}
+	size_t chunk = iov[i].iov_len - off;
+	if (chunk > room) chunk = room;
+	size_t pos = head & (SHM_RING_SIZE - 1);
+	if (chunk > SHM_RING_SIZE - pos) chunk = SHM_RING_SIZE - pos;
+	memcpy(out->data + pos, (const char *)iov[i].iov_base + off, chunk);
+	head += chunk;
+	done += chunk;
+	off += chunk;
+	if (off == iov[i].iov_len) {
+	    i++;
+	    off = 0;
+	}
+	__sync_synchronize();
+	out->head = head;
+    }
+    return done;
+}
+
+void ShmLink::wake_reader()
+{
+    __sync_synchronize();
+    if (out->sleeping) {
+	out->sleeping = 0;
+	wake(peerfd);
+    }
+}
+
+void ShmLink::wake_self()
+{
+    wake(myfd);
+}
+
+static socklen_t shm_address(in_port_t port, struct sockaddr_un &sun)
+{
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    // Abstract namespace: no file to clean up
+    int len = snprintf(sun.sun_path + 1, sizeof(sun.sun_path) - 1, "dkg-shm-%u", (unsigned int)port);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+int shm_listen(in_port_t port)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_un sun;
+    socklen_t len = shm_address(port, sun);
+    if (bind(fd, (struct sockaddr *)&sun, len) < 0 || listen(fd, 64) < 0) {
+	perror("shm_listen");
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+int shm_connect(in_port_t port)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    struct sockaddr_un sun;
+    socklen_t len = shm_address(port, sun);
+    if (connect(fd, (struct sockaddr *)&sun, len) < 0) {
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
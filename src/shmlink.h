@@ -0,0 +1,81 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#ifndef __SHMLINK_H__
+#define __SHMLINK_H__
+
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <stddef.h>
+
+using namespace std;
+
+//Bytes in each direction between two nodes on the same host
+#define SHM_RING_SIZE (1 << 20)
+
+//A connection between two nodes on the same host: a byte ring each way
+//in one shared memory segment, and an eventfd on each side that the other
+//side signals once it has put something in an empty ring or made room in
+//a full one. The unix socket it is set up over passes the segment and the
+//eventfds, and tells each side when the other is gone.
+class ShmLink {
+    public:
+	ShmLink(bool initiator);
+	~ShmLink();
+
+	//Initiator: make the segment and our eventfd and send them over sock
+	bool offer(int sock);
+	//Take the other side's part of the setup off sock: <0 if it is gone or
+	//sent something else, 0 if it has not come yet, 1 once the link is up
+	int answer(int sock);
+	bool is_up() const { return up; }
+	//Readable when the other side has signalled us
+	int get_eventfd() const { return myfd; }
+	void clear();
+
+	//Take up to len bytes out of our incoming ring
+	size_t read(char *buf, size_t len);
+	//Called when read() found nothing; false if something came in meanwhile
+	bool sleep();
+	//Put as much of iov into our outgoing ring as fits
+	size_t writev(const struct iovec *iov, int iovcnt);
+	//Signal the other side if it is not looking at the ring we wrote to
+	void wake_reader();
+	//Have the reactor report us again, for input left in the ring
+	void wake_self();
+
+    private:
+	bool initiator;
+	bool up;
+	char *base;
+	struct ShmRing *in, *out;
+	int myfd, peerfd;
+
+	bool map_segment(int memfd);
+	static void wake(int fd);
+
+	// Prevent copying
+	ShmLink(const ShmLink &);
+	ShmLink &operator=(const ShmLink &);
+};
+
+//Unix sockets (in the abstract namespace) named by the node's TCP port,
+//over which co-located nodes set up their links
+int shm_listen(in_port_t port);
+int shm_connect(in_port_t port);
+
+#endif
@@ -0,0 +1,195 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "sigpool.h"
+#include "buddyset.h"
+#include "ed25519.h"
+#include "dsa.h"
+#include "io.h"
+
+//Don't split jobs into pieces smaller than this
+#define SIGPOOL_MIN_PIECE 16
+//Bound on signatures remembered by a SigCache
+#define SIG_CACHE_ENTRIES 65536
+
+string SigCache::key(NodeID signer, const unsigned char *data, size_t len,
+					 const unsigned char *sig, size_t siglen){
+	unsigned char digest[32];
+	gcry_md_hash_buffer(GCRY_MD_SHA256, digest, data, len);
+	string key((const char *)&signer, sizeof(signer));
+	key.append((const char *)digest, 32);
+	key.append((const char *)sig, siglen);
+	return key;
+}
+
+void SigCache::add(const string& key){
+	if (!keys.insert(key).second) return;
+	order.push(key);
+	if (order.size() > SIG_CACHE_ENTRIES){
+		keys.erase(order.front());
+		order.pop();
+	}
+}
+
+SigJob::~SigJob(){
+	map <NodeID, gcry_sexp_t>::iterator it;
+	for (it = dsaKeys.begin(); it != dsaKeys.end(); ++it) gcry_sexp_release(it->second);
+}
+
+void SigJob::add(const Buddy *signer, const unsigned char *data, size_t len,
+				 const unsigned char *sig, const string& tag){
+	//All signatures of a bundle are on the same bytes
+	if (data != lastData || len != lastLen || this->data.empty()) {
+		this->data.push_back(string((const char *)data, len));
+		lastData = data; lastLen = len;
+	}
+	NodeID id = signer->get_id();
+	size_t siglen = signer->sig_size();
+	if (signer->get_ed25519_pubkey().size()) {
+		ed25519Keys[id] = signer->get_ed25519_pubkey();
+	} else if (!dsaKeys.count(id)) {
+		gcry_sexp_t key = NULL;
+		if (signer->get_dsa_pubkey())
+			gcry_sexp_build(&key, NULL, "%S", signer->get_dsa_pubkey());
+		dsaKeys[id] = key;
+	}
+	entry e = {id, (const unsigned char *)this->data.back().data(), len, sigs.size()};
+	sigs.append((const char *)sig, siglen);
+	entries.push_back(e);
+	entryTags.push_back(tag);
+	cache = &signer->get_buddyset().get_sig_cache();
+}
+
+void SigJob::remember() const{
+	if (!cache) return;
+	for (size_t i = 0; i < entryTags.size(); ++i) cache->add(entryTags[i]);
+}
+
+bool SigJob::check(size_t begin, size_t end) const{
+	Ed25519Batch batch;
+	for (size_t i = begin; i < end; ++i) {
+		const entry& e = entries[i];
+		const unsigned char *sig = (const unsigned char *)sigs.data() + e.sig;
+		map <NodeID, string>::const_iterator ed = ed25519Keys.find(e.signer);
+		if (ed != ed25519Keys.end())
+			batch.add(ed->second, e.data, e.len, sig);
+		else if (dsa_verify(dsaKeys.find(e.signer)->second, e.data, e.len, sig) < 0)
+			return false;
+	}
+	return batch.verify();
+}
+
+void SigJob::report_to(bool *valid){
+	this->valid = valid;
+	if (!*valid) {
+		entries.clear();
+		entryTags.clear();
+	}
+}
+
+SigPool::SigPool(){
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	nworkers = cpus > 1 ? cpus : 1;
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond, NULL);
+	if (pipe(pipefd) < 0) {
+		perror("pipe");
+		exit(1);
+	}
+	fcntl(pipefd[0], F_SETFL, O_NONBLOCK);
+	started = false;
+}
+
+//The workers are started with the first job, so that pools that never get
+//one (many simulated nodes in one process, say) cost no threads
+void SigPool::start_workers(){
+	for (size_t i = 0; i < nworkers; ++i) {
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		pthread_t threadid;
+		pthread_create(&threadid, &attr, launch_worker, this);
+	}
+	started = true;
+}
+
+void *SigPool::launch_worker(void *arg){
+	((SigPool *)arg)->worker();
+	return NULL;
+}
+
+void SigPool::submit(SigJob *job, Message *msg, NodeID sender){
+	if (!started) start_workers();
+	job->msg = msg;
+	job->sender = sender;
+	size_t size = job->size();
+	size_t npieces = (size + SIGPOOL_MIN_PIECE - 1) / SIGPOOL_MIN_PIECE;
+	if (npieces > nworkers) npieces = nworkers;
+	if (npieces == 0) npieces = 1;
+	pthread_mutex_lock(&mutex);
+	job->pending = npieces;
+	for (size_t i = 0; i < npieces; ++i) {
+		piece p = {job, size * i / npieces, size * (i + 1) / npieces};
+		pieces.push(p);
+	}
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+}
+
+void SigPool::worker(){
+	while (1) {
+		pthread_mutex_lock(&mutex);
+		while (pieces.empty()) pthread_cond_wait(&cond, &mutex);
+		piece p = pieces.front();
+		pieces.pop();
+		//Skip the rest of a job that has already failed
+		bool skip = !p.job->ok;
+		pthread_mutex_unlock(&mutex);
+
+		bool ok = skip || p.job->check(p.begin, p.end);
+
+		pthread_mutex_lock(&mutex);
+		if (!ok) p.job->ok = false;
+		bool finished = --p.job->pending == 0;
+		if (finished) done.push(p.job);
+		pthread_mutex_unlock(&mutex);
+		if (finished) {
+			char c = 0;
+			write(pipefd[1], &c, 1);
+		}
+	}
+}
+
+Message *SigPool::get_done(NodeID& sender){
+	char c;
+	if (read(pipefd[0], &c, 1) != 1) return NULL;
+	pthread_mutex_lock(&mutex);
+	SigJob *job = done.front();
+	done.pop();
+	pthread_mutex_unlock(&mutex);
+
+	if (job->valid) *job->valid = *job->valid && job->ok;
+	if (job->ok) job->remember();
+	Message *msg = job->msg;
+	sender = job->sender;
+	delete job;
+	return msg;
+}
@@ -0,0 +1,124 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#ifndef __SIGPOOL_H__
+#define __SIGPOOL_H__
+
+#include <pthread.h>
+#include <list>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+#include <gcrypt.h>
+#include "systemparam.h"
+#include "message.h"
+
+using namespace std;
+
+//Signatures one node has already found good, so that the copies forwarded
+//inside LEADER_CHANGE and DKG_SEND messages are not verified again. Only
+//used from the protocol thread.
+class SigCache {
+public:
+  static string key(NodeID signer, const unsigned char *data, size_t len,
+					const unsigned char *sig, size_t siglen);
+  bool has(const string& key) const {return keys.count(key) != 0;}
+  void add(const string& key);
+
+private:
+  set <string> keys;
+  queue <string> order;
+};
+
+//Signatures by other nodes carried in one message, to be checked away from
+//the protocol thread. The signed bytes and the keys are copied in, so the
+//job does not depend on the message or the buddies after add().
+class SigJob {
+public:
+  SigJob(): lastData(NULL), lastLen(0), cache(NULL), valid(NULL), msg(NULL), pending(0), ok(true) {}
+  ~SigJob();
+  //tag is the key of the signature in the SigCache of the node reading it
+  void add(const class Buddy *signer, const unsigned char *data, size_t len,
+		   const unsigned char *sig, const string& tag);
+  size_t size() const {return entries.size();}
+  //Check entries [begin, end); may be called from any thread
+  bool check(size_t begin, size_t end) const;
+  //Put the tags into the reading node's cache, once the job checked out
+  void remember() const;
+  //The result of the job is and-ed into *valid when it is done. Nothing is
+  //left to do if *valid is already false.
+  void report_to(bool *valid);
+
+private:
+  SigJob(const SigJob&);
+  SigJob& operator=(const SigJob&);
+
+  struct entry {
+	NodeID signer;
+	const unsigned char *data;
+	size_t len;
+	size_t sig;//offset in sigs
+  };
+  vector <entry> entries;
+  vector <string> entryTags;
+  string sigs;
+  list <string> data;
+  const unsigned char *lastData;
+  size_t lastLen;
+  map <NodeID, string> ed25519Keys;
+  map <NodeID, gcry_sexp_t> dsaKeys;
+  SigCache *cache;
+
+  friend class SigPool;
+  bool *valid;
+  Message *msg;
+  NodeID sender;
+  size_t pending;//pieces not checked yet
+  bool ok;
+};
+
+//Worker threads for SigJobs. A message handed in with submit() comes back
+//from get_done() once all pieces of its job are checked; get_fd() becomes
+//readable when that is the case.
+class SigPool {
+public:
+  SigPool();
+  int get_fd() const {return pipefd[0];}
+  void submit(SigJob *job, Message *msg, NodeID sender);
+  //Next message whose job is done, with its result set, or NULL
+  Message *get_done(NodeID& sender);
+
+private:
+  struct piece {
+	SigJob *job;
+	size_t begin, end;
+  };
+  size_t nworkers;
+  bool started;
+  queue <piece> pieces;
+  queue <SigJob*> done;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int pipefd[2];
+
+  void start_workers();
+  static void *launch_worker(void *arg);
+  void worker();
+};
+#endif
@@ -0,0 +1,238 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#include <iomanip>
+#include "simbus.h"
+#include "application.h"
+#include "networkmessage.h"
+#include "timer.h"
+
+static const char *type_names[] = {
+  "NET_MSG_NONE", "NET_MSG_PING", "NET_MSG_PONG",
+  "VSS_SEND", "VSS_ECHO", "VSS_READY", "VSS_SHARED", "VSS_HELP",
+  "DKG_SEND", "DKG_ECHO", "DKG_READY", "DKG_HELP", "LEADER_CHANGE",
+  "RECONSTRUCT_SHARE", "PUBLIC_KEY_EXCHANGE", "BLS_SIGNATURE_REQUEST",
+  "BLS_SIGNATURE_RESPONSE", "WRONG_BLS_SIGNATURES", "VERIFIED_BLS_SIGNATURES",
+  "VSS_COMMITMENT_REQUEST", "VSS_COMMITMENT", "VSS_SEND_FRAGMENT", "VSS_FRAGMENT"
+};
+
+SimBus::SimBus(const SimNetwork &network): network(network), seq(0),
+    randstate(1), nodeCount(0), running(NODEID_NONE)
+{
+    set_time(0);
+}
+
+void SimBus::set_time(SimTime t)
+{
+    current = t;
+    clock.tv_sec = t / 1000000;
+    clock.tv_usec = t % 1000000;
+}
+
+SimTime SimBus::cpu_used() const
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (ts.tv_sec - cpuStart.tv_sec) * 1000000LL +
+	(ts.tv_nsec - cpuStart.tv_nsec) / 1000;
+}
+
+// Where the node being run has got to
+SimTime SimBus::now() const
+{
+    if (running == NODEID_NONE) return current;
+    return current + cpu_used();
+}
+
+unsigned long SimBus::next_random()
+{
+    randstate = randstate * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned long)(randstate >> 33);
+}
+
+void SimBus::send(NodeID from, NodeID to, const OutMsg &msg)
+{
+    size_t size = msg.size();
+    SimTime tx = network.bandwidth ? size * 1000000ULL / network.bandwidth : 0;
+
+    // Out over the sender's link, after what it sent before
+    SimTime &up = upFree[from];
+    SimTime depart = now();
+    if (depart < up) depart = up;
+    depart += tx;
+    up = depart;
+
+    SimTime arrive = depart + network.latency;
+    if (network.jitter) arrive += next_random() % (network.jitter + 1);
+
+    // In over the receiver's link, which everyone sending to it shares
+    SimTime &down = downFree[to];
+    if (arrive < down + tx) arrive = down + tx;
+    down = arrive;
+
+    // Not ahead of what came before on the same connection
+    SimTime &last = lastArrival[make_pair(from, to)];
+    if (arrive < last) arrive = last;
+    last = arrive;
+
+    Event ev;
+    ev.when = arrive;
+    ev.seq = seq++;
+    ev.from = from;
+    ev.to = to;
+    ev.msg = msg;
+    events.push(ev);
+
+    Traffic &bytype = byType[msg.type()];
+    bytype.count++;
+    bytype.bytes += size;
+    Traffic &sent = sentBy[from];
+    sent.count++;
+    sent.bytes += size;
+}
+
+void SimBus::begin(NodeID id)
+{
+    running = id;
+    Timer::set_owner(id);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
+}
+
+void SimBus::finish(NodeID id, Application *app)
+{
+    BuddyID buddyID;
+    Message *msg;
+    while ((msg = app->get_replayed(buddyID)) != NULL)
+	app->handle(msg, buddyID);
+
+    SimTime used = cpu_used();
+    cpu[id] += used;
+    busyUntil[id] = current + used;
+    running = NODEID_NONE;
+    if (app->finished()) finished.insert(id);
+}
+
+void SimBus::run(const map<NodeID, Application*> &nodes, SimTime limit)
+{
+    map<NodeID, Application*>::const_iterator iter, other;
+    nodeCount = nodes.size();
+    Timer::set_clock(&clock);
+
+    // Nothing is connected, so nothing is exchanged on connecting
+    for (iter = nodes.begin(); iter != nodes.end(); ++iter) {
+	iter->second->attach_bus(this);
+	const string &record = iter->second->get_bls_record();
+	if (record.empty()) continue;
+	for (other = nodes.begin(); other != nodes.end(); ++other) {
+	    if (other != iter) other->second->set_bls_record(iter->first, record);
+	}
+    }
+
+    for (iter = nodes.begin(); iter != nodes.end(); ++iter) {
+	begin(iter->first);
+	iter->second->start();
+	finish(iter->first, iter->second);
+    }
+
+    while (current <= limit && finished.size() < nodes.size()) {
+	struct timeval tv;
+	bool timerPending = Timer::time_to_next(&tv) != NULL;
+	SimTime timerAt = current + tv.tv_sec * 1000000ULL + tv.tv_usec;
+	if (!timerPending && events.empty()) break;
+
+	if (timerPending && (events.empty() || timerAt <= events.top().when)) {
+	    set_time(timerAt);
+	    int owner;
+	    TimerMessage *tmsg = Timer::get_next(&owner);
+	    if (!tmsg) continue;
+	    iter = nodes.find(owner);
+	    if (iter == nodes.end()) {
+		delete tmsg;
+		continue;
+	    }
+	    // Timer messages come from buddy 0
+	    begin(owner);
+	    iter->second->handle(tmsg, 0);
+	    finish(owner, iter->second);
+	    continue;
+	}
+
+	Event ev = events.top();
+	events.pop();
+	// A node still busy with the last message gets this one after it
+	SimTime &busy = busyUntil[ev.to];
+	if (ev.when < busy) {
+	    ev.when = busy;
+	    events.push(ev);
+	    continue;
+	}
+	set_time(ev.when);
+	iter = nodes.find(ev.to);
+	if (iter == nodes.end()) continue;
+
+	string msgstr;
+	msgstr.reserve(ev.msg.size());
+	for (int i = 0; i < ev.msg.npieces; i++)
+	    msgstr.append(ev.msg.pieces[i].data(), ev.msg.pieces[i].size());
+	begin(ev.to);
+	Message *msg = iter->second->deliver(ev.from, msgstr);
+	if (msg) iter->second->handle(msg, ev.from);
+	finish(ev.to, iter->second);
+    }
+
+    Timer::set_clock(NULL);
+}
+
+void SimBus::report(ostream &out) const
+{
+    out << "Simulated " << nodeCount << " nodes, " << finished.size()
+	<< " finished, in " << current / 1000 << " ms virtual time\n";
+
+    Traffic total;
+    map<int, Traffic>::const_iterator titer;
+    for (titer = byType.begin(); titer != byType.end(); ++titer) {
+	int type = titer->first;
+	const char *name = type >= 0 &&
+	    type < (int)(sizeof(type_names) / sizeof(type_names[0])) ?
+	    type_names[type] : "UNKNOWN";
+	out << "  " << left << setw(24) << name << right
+	    << setw(10) << titer->second.count
+	    << setw(14) << titer->second.bytes << " bytes\n";
+	total.count += titer->second.count;
+	total.bytes += titer->second.bytes;
+    }
+    out << "  " << left << setw(24) << "total" << right
+	<< setw(10) << total.count << setw(14) << total.bytes << " bytes\n";
+
+    unsigned long long maxSent = 0;
+    map<NodeID, Traffic>::const_iterator siter;
+    for (siter = sentBy.begin(); siter != sentBy.end(); ++siter) {
+	if (siter->second.bytes > maxSent) maxSent = siter->second.bytes;
+    }
+    SimTime cpuTotal = 0, cpuMax = 0;
+    map<NodeID, SimTime>::const_iterator citer;
+    for (citer = cpu.begin(); citer != cpu.end(); ++citer) {
+	cpuTotal += citer->second;
+	if (citer->second > cpuMax) cpuMax = citer->second;
+    }
+    if (nodeCount) {
+	out << "Bytes sent per node: " << total.bytes / nodeCount
+	    << " mean, " << maxSent << " max\n";
+	out << "CPU per node: " << cpuTotal / nodeCount / 1000 << " ms mean, "
+	    << cpuMax / 1000 << " ms max, " << cpuTotal / 1000 << " ms in all\n";
+    }
+}
@@ -0,0 +1,113 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+#ifndef __SIMBUS_H__
+#define __SIMBUS_H__
+
+#include <sys/time.h>
+#include <time.h>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+#include "systemparam.h"
+#include "sendring.h"
+
+using namespace std;
+
+typedef unsigned long long SimTime;//Virtual time in microseconds
+
+//How long messages take on the simulated network. Every node has a link
+//of the given bandwidth (bytes per second; 0 for no limit) each way, and
+//a message is latency plus up to jitter microseconds in flight in between.
+//Messages between two nodes arrive in order, as over TCP.
+struct SimNetwork {
+    SimTime latency;
+    SimTime jitter;
+    unsigned long long bandwidth;
+};
+
+//Runs many nodes in one process: messages are handed over in memory, and
+//a virtual clock, which Timer reads, moves from one event to the next.
+//The CPU time a node takes for a message is charged to the virtual clock
+//too, so a busy node falls behind as it would on its own machine.
+class SimBus {
+public:
+    SimBus(const SimNetwork &network);
+
+    //Called (through Buddy::write_message) by the node being run
+    void send(NodeID from, NodeID to, const OutMsg &msg);
+
+    //Start the nodes and run them until all are finished, no message or
+    //timer is left, or the virtual clock gets to limit
+    void run(const map<NodeID, class Application*> &nodes, SimTime limit);
+
+    //Virtual time, message counts by type and CPU time per node
+    void report(ostream &out) const;
+
+private:
+    struct Event {
+	SimTime when;
+	unsigned long seq;//Keeps events at the same time in order
+	NodeID from, to;
+	OutMsg msg;
+    };
+    struct Later {
+	bool operator()(const Event &a, const Event &b) const {
+	    return a.when > b.when || (a.when == b.when && a.seq > b.seq);
+	}
+    };
+    struct Traffic {
+	Traffic(): count(0), bytes(0) {}
+	unsigned long count;
+	unsigned long long bytes;
+    };
+
+    SimNetwork network;
+    priority_queue<Event, vector<Event>, Later> events;
+    unsigned long seq;
+    unsigned long long randstate;
+    SimTime current;
+    struct timeval clock;//current, for Timer
+
+    //When each node's links are free again, and when the node is done
+    //with what it is working on
+    map<NodeID, SimTime> upFree, downFree, busyUntil;
+    map<pair<NodeID, NodeID>, SimTime> lastArrival;
+
+    map<int, Traffic> byType;
+    map<NodeID, Traffic> sentBy;
+    map<NodeID, SimTime> cpu;
+    set<NodeID> finished;
+    size_t nodeCount;
+
+    //The node being run, and its thread CPU time when it started
+    NodeID running;
+    struct timespec cpuStart;
+
+    void set_time(SimTime t);
+    SimTime now() const;
+    SimTime cpu_used() const;
+    unsigned long next_random();
+    //Around running the node id: finish() hands it what it put back to be
+    //replayed and charges it the CPU time used since begin()
+    void begin(NodeID id);
+    void finish(NodeID id, class Application *app);
+};
+
+#endif
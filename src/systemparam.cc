@@ -59,7 +59,7 @@
 
 SystemParam::SystemParam(const char *pairingParamFileStr, 
 						 const char *sysParamFileStr)
-  :e(fopen(pairingParamFileStr,"r")), U(G1(e,true)),n(0),t(0),f(0)
+  :e(fopen(pairingParamFileStr,"r")), U(G1(e,true)),n(0),t(0),f(0),certificates(false),commitmentDigests(false),commitmentFragments(false)
   {
   string typeStr;
   /*  char typeStr[6];
@@ -98,6 +98,9 @@ SystemParam::SystemParam(const char *pairingParamFileStr,
 	  if(typeStr == "phaseDuration") {
 		sysParamFStream>>phaseDuration;continue;
 	  }
+	  if(typeStr == "certificates") {sysParamFStream >> certificates;continue;}
+	  if(typeStr == "commitmentdigests") {sysParamFStream >> commitmentDigests;continue;}
+	  if(typeStr == "commitmentfragments") {sysParamFStream >> commitmentFragments;continue;}
     }
     if(n < 3*t + 2*f +1) 
     	throw InvalidSystemParamFileException("n,t and f does not follow n >= 3t+ 2f +1");
@@ -26,6 +26,10 @@
 #include <fstream>
 #include <string>
 #include <iostream>
+#include <map>
+#include <queue>
+#include <vector>
+#include <pthread.h>
 
 using namespace std;
 
@@ -34,6 +38,16 @@ typedef unsigned short NodeIDSize;
 #define NODEID_NONE 0xffff
 typedef unsigned int Phase;
 
+//G1 runs decoded by read_G1s, by their encoding, for one SystemParam
+struct G1RunCache{
+  G1RunCache(): bytes(0) {pthread_mutex_init(&mutex, NULL);}
+  ~G1RunCache() {pthread_mutex_destroy(&mutex);}
+  map<string, vector<G1> > runs;
+  queue<string> order;
+  size_t bytes;//Encodings plus decoded points
+  pthread_mutex_t mutex;
+};
+
 
 class SystemParam{
 public:
@@ -41,7 +55,7 @@ public:
 			  const char* sysParamFileStr = "system.param");
   //SystemParam(FILE *pairingParamFile = fopen("pairing.param", "r"),
   //	  FILE* sysParamFile = fopen("system.param", "r"));
-  ~SystemParam(){};
+  ~SystemParam(){};//The G1 runs go before the Pairing they belong to
   NodeID get_n () const {return n; }
   void set_n(NodeID nodeCount){ n= nodeCount; }
   NodeID get_t () const{ return t; }
@@ -50,6 +64,13 @@ public:
   void set_f(NodeID threshold){ f = threshold; }
   const G1& get_U () const{return U;}
   const Pairing& get_Pairing () const{return e;}
+  //Nodes sign with BLS keys so signature sets travel as aggregated certificates
+  bool use_certificates () const{return certificates;}
+  //VSS_ECHO and VSS_READY name a matrix commitment by its digest
+  bool use_commitment_digests () const{return commitmentDigests || commitmentFragments;}
+  //The dealer sends each node one erasure coded fragment of a matrix commitment
+  bool use_commitment_fragments () const{return commitmentFragments;}
+  G1RunCache &get_g1_cache () const{return g1Cache;}
 
 private:    
   // Prevent copying
@@ -62,6 +83,10 @@ private:
   NodeID t; //Byzantine Threshold
   NodeID f; //Crash-Recovery and Link Failure Threshold 
   float phaseDuration; //in minutes
+  bool certificates;
+  bool commitmentDigests;
+  bool commitmentFragments;
+  mutable G1RunCache g1Cache;//Declared after e, so destroyed before it
   //Map_to_point has is directly used from the PBC library's
   //element_from_hash()
 };
@@ -0,0 +1,80 @@
+//  Distributed Key Generator
+//  Copyright 2012 Aniket Kate <aniket@mpi-sws.org>, Andy Huang <y226huan@uwaterloo.ca>, Ian Goldberg <iang@uwaterloo.ca>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of version 3 of the GNU General Public License as
+//  published by the Free Software Foundation.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  There is a copy of the GNU General Public License in the COPYING file
+//  packaged with this plugin; if you cannot find it, write to the Free
+//  Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//  MA 02110-1301 USA
+
+//Stress test for sharing one Pairing between threads: every thread builds
+//commitment matrices and checks good and bad shares against them.
+//Usage: threadtest [threads] [rounds], with pairing.param and system.param
+//in the current directory.
+
+#include <iostream>
+#include <stdlib.h>
+#include <pthread.h>
+#include "bipolynomial.h"
+#include "commitmentmatrix.h"
+#include "systemparam.h"
+
+static SystemParam *param;
+static unsigned int rounds = 20;
+
+static void *run(void *arg)
+{
+	long failures = 0;
+	const Pairing &e = param->get_Pairing();
+	NodeIDSize t = param->get_t();
+	for (unsigned int round = 0; round < rounds; ++round) {
+		BiPolynomial fxy(*param, t);
+		CommitmentMatrix C(*param, fxy);
+		//The commitment has to come back the same after serialization
+		string str = C.toString();
+		const unsigned char *buf = (const unsigned char *)str.data();
+		size_t len = str.size();
+		CommitmentMatrix copy(*param, buf, len);
+		if (!(copy == C)) ++failures;
+
+		NodeID dealt = 1 + round % (t + 2), other = 2 + round % (t + 3);
+		Polynomial a = fxy(Zr(e, (long)dealt));
+		Zr alpha = a(Zr(e, (long)other));
+		if (!C.verifyPoly(*param, dealt, a)) ++failures;
+		if (!C.verifyPoly(*param, dealt, a, false)) ++failures;
+		if (!C.verifyPoint(*param, dealt, other, alpha)) ++failures;
+		//Wrong shares must be caught
+		Zr wrong = alpha + Zr(e, (long)1);
+		if (C.verifyPoint(*param, dealt, other, wrong)) ++failures;
+		if (C.verifyPoly(*param, other, a)) ++failures;
+	}
+	return (void *)failures;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int nthreads = argc > 1 ? atoi(argv[1]) : 8;
+	if (argc > 2) rounds = atoi(argv[2]);
+	param = new SystemParam("pairing.param", "system.param");
+
+	pthread_t threads[nthreads];
+	for (unsigned int i = 0; i < nthreads; ++i)
+		pthread_create(&threads[i], NULL, run, NULL);
+	long failures = 0;
+	for (unsigned int i = 0; i < nthreads; ++i) {
+		void *res;
+		pthread_join(threads[i], &res);
+		failures += (long)res;
+	}
+	cout << nthreads << " threads x " << rounds << " rounds: "
+		 << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
@@ -21,6 +21,8 @@
 
 static Timer *first = NULL;
 static TimerID nextid = 0;
+static const struct timeval *virtual_clock = NULL;
+static int current_owner = 0;
 
 static void add_ms(struct timeval *resp, const struct timeval *tm,
 	int ms)
@@ -39,18 +41,34 @@ static int diff_ms(struct timeval *a, struct timeval *b)
 }
 
 Timer::Timer(const struct timeval *whenp, TimerMessage *msg) :
-    when(*whenp), msg(msg)
+    when(*whenp), msg(msg), owner(current_owner)
 {
     id = ++(nextid);
     next = NULL;
     this->msg->set_id(id);
 }
 
+void Timer::set_clock(const struct timeval *clock)
+{
+    virtual_clock = clock;
+}
+
+void Timer::set_owner(int owner)
+{
+    current_owner = owner;
+}
+
+void Timer::now(struct timeval *tv)
+{
+    if (virtual_clock) *tv = *virtual_clock;
+    else gettimeofday(tv, NULL);
+}
+
 TimerID Timer::new_timer(TimerMessage *msg, unsigned int ms)
 {
     // When should this timer go off?
     struct timeval now, then;
-    gettimeofday(&now, NULL);
+    Timer::now(&now);
     add_ms(&then, &now, ms);
 
     // Make a new Timer node
@@ -93,7 +111,7 @@ struct timeval *Timer::time_to_next(struct timeval *tv)
 
     struct timeval now;
 
-    gettimeofday(&now, NULL);
+    Timer::now(&now);
 
     int diffms = diff_ms(&(first->when), &now);
     if (diffms > 0) {
@@ -107,13 +125,13 @@ struct timeval *Timer::time_to_next(struct timeval *tv)
     return tv;
 }
 
-TimerMessage *Timer::get_next()
+TimerMessage *Timer::get_next(int *owner)
 {
     if (first == NULL) return NULL;
 
     struct timeval now;
 
-    gettimeofday(&now, NULL);
+    Timer::now(&now);
 
     TimerMessage *ret;
 
@@ -125,6 +143,7 @@ TimerMessage *Timer::get_next()
 	first = first->next;
 	touse->next = NULL;
 	ret = touse->msg;
+	if (owner) *owner = touse->owner;
 	touse->msg = NULL;
 	delete touse;
     }
@@ -36,8 +36,20 @@ class Timer {
 	// unless no timers pending; in that case, return NULL
 	static struct timeval *time_to_next(struct timeval *tv);
 
-	// Extract the first pending timeout, if it is available
-	static TimerMessage *get_next();
+	// Extract the first pending timeout, if it is available. owner is
+	// set to the owner it was made under.
+	static TimerMessage *get_next(int *owner = NULL);
+
+	// Read the time from *clock instead of the system clock (for a
+	// simulation, which moves it on); NULL goes back to the system clock
+	static void set_clock(const struct timeval *clock);
+
+	// Tag the timers made from now on, for several nodes in one process
+	static void set_owner(int owner);
+
+	// The time timeouts are measured against: the system clock, or the
+	// simulation clock while one is set
+	static void now(struct timeval *tv);
 
     private:
 	Timer(const struct timeval *whenp, TimerMessage *msg);
@@ -45,6 +57,7 @@ class Timer {
 	TimerID id;
 	struct timeval when;
 	TimerMessage *msg;
+	int owner;
 	Timer *next;
 };
 
@@ -63,6 +63,10 @@ UserMessage *UserMessage::read_message()
 	  string paramStr = command.substr(5);
 	  return new BLSSignatureRequestUserMessage(paramStr);
     }
+    if (!strncmp(cmdstr, "verify ",7)) {
+	  string paramStr = command.substr(7);
+	  return new BLSVerifyUserMessage(paramStr);
+    }
     return new UserMessage();
 }
 
@@ -30,7 +30,7 @@ typedef enum {IN, OUT} IOType;
 typedef enum {
     USER_MSG_NONE,
 	SHARE, CONFIRM_LEADER, SHARED, RECOVER, RECONSTRUCT, DKG_COMPLETE, 
-	STATE_INFORMATION, SIGN, USER_MSG_PING
+	STATE_INFORMATION, SIGN, USER_MSG_PING, VERIFY_SIGNATURES
 } UserMessageType;
 
 //class for network messages in the system
@@ -155,4 +155,11 @@ public:
 		
 	string msg;
 };
+
+class BLSVerifyUserMessage: public UserMessage {
+public:
+	BLSVerifyUserMessage(const string& str){msgtype = VERIFY_SIGNATURES; filename = str;}
+		
+	string filename;//File (or FIFO) of signatures, one per line
+};
 #endif